@@ -0,0 +1,124 @@
+// Location lookup: LocationTrie against the linear Location::matches() scan
+// it replaced in Config::findLocation. Both are run over the same generated
+// locations and URIs; any URI on which they pick a different location is a
+// failure. Build and run with `make bench`.
+
+#include "LocationTrie.hpp"
+#include "Utils.hpp"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sys/time.h>
+
+static const char* const WORDS[] = {"api", "v1", "v2", "users", "static", "img", "docs",
+                                    "a", "ab", "abc", "cgi", "upload", "x/"};
+static const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+static const size_t URI_COUNT = 20000;
+static const int ROUNDS = 50;
+
+// Keeps the timed lookups from being optimized away
+static volatile size_t g_sink;
+
+// The scan findLocation did before the trie
+static const Location* linearMatch(const std::vector<Location>& locations, const std::string& uri) {
+    const Location* best = NULL;
+    size_t bestLength = 0;
+    for (size_t i = 0; i < locations.size(); ++i) {
+        if (locations[i].matches(uri)) {
+            size_t length = locations[i].getPath().length();
+            if (length > bestLength) {
+                best = &locations[i];
+                bestLength = length;
+            }
+        }
+    }
+    return best;
+}
+
+static const Location* trieMatch(const LocationTrie& trie, const std::vector<Location>& locations,
+                                 const std::string& uri) {
+    int index = trie.match(uri);
+    return index == LocationTrie::NONE ? NULL : &locations[index];
+}
+
+// "/seg/seg..." from the word list, some segments with a number appended
+static std::string randomPath(int segments) {
+    std::string path;
+    for (int i = 0; i < segments; ++i) {
+        path += "/";
+        path += WORDS[rand() % WORD_COUNT];
+        if (rand() % 3 == 0) path += Utils::intToString(rand() % 20);
+    }
+    return path;
+}
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Returns the number of URIs on which the two lookups disagree
+static size_t run(size_t count) {
+    srand(42);
+    std::vector<Location> locations;
+    locations.push_back(Location("/"));
+    for (size_t i = 0; i < count; ++i) {
+        locations.push_back(Location(randomPath(1 + rand() % 4)));
+    }
+    locations.push_back(Location("/api")); // a repeated path: the first one wins
+
+    LocationTrie trie;
+    trie.build(locations);
+
+    // Odd shapes too: empty, "*", query strings, trailing slashes
+    std::vector<std::string> uris;
+    for (size_t i = 0; i < URI_COUNT; ++i) {
+        std::string uri = (rand() % 50 == 0) ? "*" : "";
+        if (uri.empty()) uri = randomPath(rand() % 6);
+        if (rand() % 4 == 0) uri += "?q=1";
+        if (rand() % 5 == 0) uri += "/";
+        uris.push_back(uri);
+    }
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < uris.size(); ++i) {
+        if (trieMatch(trie, locations, uris[i]) != linearMatch(locations, uris[i])) {
+            if (mismatches++ < 5) std::cout << "  mismatch on \"" << uris[i] << "\"" << std::endl;
+        }
+    }
+
+    size_t sink = 0;
+    double start = now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (size_t i = 0; i < uris.size(); ++i) sink += (size_t)linearMatch(locations, uris[i]);
+    }
+    double linear = now() - start;
+    start = now();
+    for (int round = 0; round < ROUNDS; ++round) {
+        for (size_t i = 0; i < uris.size(); ++i) sink += (size_t)trieMatch(trie, locations, uris[i]);
+    }
+    double indexed = now() - start;
+    g_sink = sink;
+
+    double lookups = (double)ROUNDS * uris.size();
+    std::cout << std::setw(9) << locations.size() << std::setw(12) << trie.size() << std::fixed
+              << std::setprecision(0) << std::setw(14) << linear / lookups * 1e9 << std::setw(12)
+              << indexed / lookups * 1e9 << std::setprecision(1) << std::setw(9) << linear / indexed << "x" << std::endl;
+    return mismatches;
+}
+
+int main() {
+    static const size_t SIZES[] = {10, 100, 300, 1000};
+    std::cout << "locations  trie nodes  linear ns/op  trie ns/op   speedup" << std::endl;
+    size_t mismatches = 0;
+    for (size_t i = 0; i < sizeof(SIZES) / sizeof(SIZES[0]); ++i) {
+        mismatches += run(SIZES[i]);
+    }
+    if (mismatches) {
+        std::cout << mismatches << " lookups disagree with the linear scan" << std::endl;
+        return 1;
+    }
+    std::cout << "trie and linear scan agree on every lookup" << std::endl;
+    return 0;
+}
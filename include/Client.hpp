@@ -7,6 +7,13 @@
 #include "CGI.hpp"
 #include "Config.hpp"
 #include "Location.hpp"
+#include "TimerWheel.hpp"
+#include "SendBuffer.hpp"
+#include "FileCache.hpp"
+#include "ContentCache.hpp"
+#include "VariantCache.hpp"
+#include "Compression.hpp"
+#include "Range.hpp"
 
 class Client {
 public:
@@ -17,17 +24,37 @@ public:
         CGI_PROCESSING,
         CGI_SENDING_HEADERS,
         CGI_STREAMING_BODY,
+        WAITING_FOR_WORKER, // response body out on the worker pool
         FINISHED,
         ERROR_STATE
     };
 
+    // Per-connection timers, scheduled by the owning Server's TimerWheel
+    enum TimerKind {
+        TIMER_IDLE,
+        TIMER_HEADER,
+        TIMER_CHUNKED,
+        TIMER_CGI,
+        TIMER_COUNT
+    };
+
 private:
+    // Body compressed while it is sent, as chunks: a file read and deflated
+    // block by block as the send buffer drains, or CGI output as it arrives
+    struct BodyEncoder {
+        Compression::Stream stream;
+        int fd;           // file source, -1 when fed CGI output
+        off_t offset;
+        size_t remaining;
+    };
+
     int _fd;
+    int _listener; // index into Config::getListeners() of the accepting socket
     State _state;
     Request _request;
     Response _response;
     std::string _receiveBuffer;
-    std::string _sendBuffer;
+    SendBuffer _sendBuffer;
     std::string _cgiOutputBuffer;
     std::string _cgiInputCopy; // preserve original request body sent to CGI (for diagnostics)
     std::string _cgiWriteBuffer;
@@ -35,6 +62,17 @@ private:
     CGI* _cgi;
     size_t _cgiBytesSent;
     bool _keepAlive;
+    bool _keepAliveAllowed; // cleared by the Server above its keep-alive watermark
+    FileCache* _fileCache;  // path lookups of the serving loop, set by the Server
+    ContentCache* _contentCache; // hot file contents of the serving loop
+    VariantCache* _variantCache; // compressed bodies, shared by the loops of the process
+    std::string _servedPath;     // file behind the current response, keys its variants
+    Compression::Settings _compression; // of the location serving the current request
+    BodyEncoder* _encoder;       // set while a compressed body is being streamed
+    WorkerPool* _workerPool;     // for compressing large bodies off the loop, set by the Server
+    WorkerPool::CompletionQueue* _completions; // where the loop collects finished jobs
+    Compression::Job* _job;      // owned by the pool while WAITING_FOR_WORKER
+    std::string _jobKey;         // variant cache key the job will fill, if any
     bool _cgiFinishedWaitingForRequest; // true when CGI completed but request still incomplete
     bool _peerClosed; // true when the client has half-closed (read EOF)
     // Tracks whether we've actually sent the CGI response headers to the client.
@@ -47,6 +85,7 @@ private:
     // When CGI provides Content-Length, track how many body bytes remain to stream.
     // SIZE_MAX (or (size_t)-1) indicates unknown/not set (i.e., deferred mode).
     size_t _cgiBodyRemaining;
+    TimerWheel::Timer _timers[TIMER_COUNT];
     
 
 public:
@@ -65,11 +104,17 @@ public:
     bool isKeepAlive() const;
     CGI* getCgi() const;
     bool hasPeerClosed() const;
+    TimerWheel::Timer& getTimer(TimerKind kind);
 
     // Setters
     void setState(State state);
     void setResponse(const Response& response);
     void setKeepAlive(bool keepAlive);
+    void setKeepAliveAllowed(bool allowed);
+    void setFileCache(FileCache* cache);
+    void setContentCache(ContentCache* cache);
+    void setVariantCache(VariantCache* cache);
+    void setWorkerPool(WorkerPool* pool, WorkerPool::CompletionQueue* completions);
     void setCgi(CGI* cgi);
 
     
@@ -77,6 +122,8 @@ public:
     ssize_t receiveData();
     ssize_t sendData();
     void processRequest(const class Config& config);
+    // Resume after the worker pool has run our job (the caller deletes it)
+    void finishJob(WorkerPool::Job* job);
     
     // State management
     void updateLastActivity();
@@ -85,9 +132,15 @@ public:
     void close();
     void markPeerClosed();
 
+    // ClientPool reuse: bind a recycled Client to a new connection accepted
+    // on `listener`, and clear a closed one while keeping up to
+    // `maxBufferCapacity` of each buffer
+    void attach(int fd, int listener);
+    void recycle(size_t maxBufferCapacity);
+
     // Buffer management
     const std::string& getReceiveBuffer() const;
-    const std::string& getSendBuffer() const;
+    const SendBuffer& getSendBuffer() const;
     void clearReceiveBuffer();
     void clearSendBuffer();
     void appendToSendBuffer(const std::string& data);
@@ -110,15 +163,33 @@ private:
     // (If you prefer, remove definitions from src/Client.cpp as well.)
     // Request handlers
     Response _handleGetRequest(const Config::ServerBlock& serverConfig, const Location* location);
+    Response _serveStaticFile(FileCache& files, const FileCache::Entry& stated, const Location* location);
+    bool _isNotModified(const std::string& etag, time_t mtime) const;
+    bool _isRangeCurrent(const Response& response) const;
+    void _applyByteRanges(Response& response, const Range& range, const std::string& contentType);
     Response _handlePostRequest(const Config::ServerBlock& serverConfig, const Location* location);
     Response _handlePutRequest(const Config::ServerBlock& serverConfig, const Location* location);
     Response _handleDeleteRequest(const Config::ServerBlock& serverConfig, const Location* location);
+    void _invalidateCached(const std::string& path);
     
     // Bonus features
     void _applyBonusFeatures();
     void _applyCookieSupport();
     void _applySessionManagement();
+    Compression::CompressionType _negotiateCompression(const std::string& contentType, size_t length) const;
+    Compression::CompressionType _selectCompression(const std::string& contentType, size_t length) const;
+    std::string _variantKey(Compression::CompressionType type, const std::string& etag) const;
+    void _describeCompression(Response& response, const std::string& mimeType, size_t size);
     void _applyCompression();
+    bool _startEncodedBody(Compression::CompressionType type, int fd, off_t offset, size_t length);
+    void _pumpEncodedFile();
+    bool _startCgiEncoding();
+    void _encodeCgiOutput(const char* data, size_t length);
+    void _finishEncodedBody();
+    void _discardEncoder();
+    bool _offloadCompression(Compression::CompressionType type, const std::string& key);
+    void _cancelJob();
+    void _queueChunk(std::string& data);
     void _applyRangeRequests();
 
     size_t _cgiBodyOffset;
@@ -126,6 +197,10 @@ private:
     // Mark whether finalizeCgiResponse() has already been executed for this CGI
     bool _cgiFinalized;
     size_t _stageBodyChunkForCgi(size_t maxBytes);
+    bool _negotiateKeepAlive(bool isHttp11, const std::string& connection) const;
+    void _queueResponse(bool includeBody = true);
+    void _queueBodyParts();
+    void _initTimers();
 };
 
 #endif
@@ -0,0 +1,46 @@
+#ifndef CLIENTPOOL_HPP
+#define CLIENTPOOL_HPP
+
+#include "webserv.hpp"
+#include "Client.hpp"
+
+// Recycles Client objects of one event loop (not thread-safe: every loop
+// thread owns its own pool). Clients are carved out of slabs allocated on
+// demand, up to `capacity` objects in total; a released Client is reset but
+// keeps up to `bufferCapacity` bytes of each buffer for its next connection.
+// Demand beyond the capacity falls back to plain new/delete.
+class ClientPool {
+private:
+    static const size_t SLAB_SIZE = 64;
+
+    ClientPool(const ClientPool&);
+    ClientPool& operator=(const ClientPool&);
+
+    std::vector<Client*> _slabs;
+    std::vector<Client*> _free;
+    size_t _capacity;
+    size_t _slabbed;  // Clients carved from slabs so far
+    size_t _bufferCapacity;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _overflows;
+
+    bool _isPooled(const Client* client) const;
+    bool _growSlab();
+
+public:
+    ClientPool(size_t capacity = MAX_CLIENTS, size_t bufferCapacity = BUFFER_SIZE);
+    ~ClientPool();
+
+    // Must only be called while no Client is in use
+    void configure(size_t capacity, size_t bufferCapacity);
+
+    Client* acquire(int fd, int listener);
+    void release(Client* client);
+
+    unsigned long getHits() const;
+    unsigned long getMisses() const;
+    void logStats() const;
+};
+
+#endif
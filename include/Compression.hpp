@@ -2,6 +2,8 @@
 #define COMPRESSION_HPP
 
 #include "webserv.hpp"
+#include "SharedBuffer.hpp"
+#include "WorkerPool.hpp"
 #include <zlib.h>
 
 class Compression {
@@ -12,25 +14,77 @@ public:
         DEFLATE
     };
 
+    // Per-location tuning (gzip_level, gzip_min_length, gzip_types)
+    struct Settings {
+        int level;                      // zlib level, 1 (fastest) to 9 (smallest)
+        size_t minLength;               // shorter bodies go out as they are
+        std::vector<std::string> types; // empty: the built-in list; "*": any type
+        Settings();
+    };
+
+    // Incremental encoder over one persistent z_stream: a body fed in blocks
+    // comes out compressed block by block, so memory stays bounded however
+    // long the body is. Not copyable.
+    class Stream {
+    private:
+        z_stream _zs;
+        bool _active;
+
+        Stream(const Stream&);
+        Stream& operator=(const Stream&);
+        bool _deflate(int flush, std::string& out);
+
+    public:
+        Stream();
+        ~Stream();
+
+        bool begin(CompressionType type, int level = Z_DEFAULT_COMPRESSION);
+        // Compresses `length` more bytes; output zlib has ready is appended to `out`
+        bool write(const char* data, size_t length, std::string& out);
+        // Appends the remaining output and the trailer, and ends the stream
+        bool finish(std::string& out);
+        void end();
+        bool isActive() const;
+    };
+
+    // Compression of a body on a WorkerPool thread. The input is a reference
+    // to the body, so the submitter gives up nothing it still needs.
+    class Job : public WorkerPool::Job {
+    public:
+        SharedBuffer input;
+        size_t offset;
+        size_t length;
+        CompressionType type;
+        int level;
+        std::string output;          // empty if compression failed
+        unsigned long long cpuMicros; // spent on it by the worker
+
+        Job(const SharedBuffer& input, size_t offset, size_t length, CompressionType type, int level);
+        virtual void run();
+    };
+
 private:
     static bool _isCompressible(const std::string& contentType);
-    static std::string _simpleGzipCompress(const std::string& data);
+    static double _quality(const std::string& acceptEncoding, const std::string& coding, double unlisted);
 
 public:
-    // Check if client accepts compression
+    // The q-value Accept-Encoding gives `coding`; 0 means refused
+    static double getQuality(const std::string& acceptEncoding, const std::string& coding);
+    // Best coding the client accepts, or NONE (also when it prefers identity)
     static CompressionType getAcceptedCompression(const std::string& acceptEncoding);
-    
-    // Compress data based on type
-    static std::string compress(const std::string& data, CompressionType type);
-    
-    // Check if content should be compressed
-    static bool shouldCompress(const std::string& contentType, size_t contentLength);
-    
+    // False when identity;q=0 (or *;q=0) rules out an uncompressed body
+    static bool acceptsIdentity(const std::string& acceptEncoding);
+
+    // Compress data based on type; empty on failure
+    static std::string compress(const std::string& data, CompressionType type, int level = Z_DEFAULT_COMPRESSION);
+    static std::string compress(const char* data, size_t length, CompressionType type,
+                                int level = Z_DEFAULT_COMPRESSION);
+
+    // Check if content should be compressed (`contentLength` may be npos)
+    static bool shouldCompress(const std::string& contentType, size_t contentLength, const Settings& settings);
+
     // Get compression header value
     static std::string getEncodingHeader(CompressionType type);
-    
-    // Simple compression implementation (for demonstration)
-    static std::string simpleCompress(const std::string& data);
 };
 
 #endif
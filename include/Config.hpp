@@ -3,6 +3,7 @@
 
 #include "webserv.hpp"
 #include "Location.hpp"
+#include "LocationTrie.hpp"
 
 class Config {
 public:
@@ -15,16 +16,51 @@ public:
         size_t maxBodySize;
         std::map<int, std::string> errorPages;
         std::vector<Location> locations;
+        LocationTrie locationIndex; // over `locations`, built at load
+        bool isDefault;             // listen ... default_server
+    };
+
+    // A distinct listen address and the server blocks sharing it, indexed by
+    // lower-case server_name when the configuration is loaded. The pointers
+    // refer into this Config's own _servers, so a copy rebuilds the table.
+    struct Listener {
+        std::string host;
+        int port;
+        size_t servers;                   // server blocks listening here
+        const ServerBlock* defaultServer; // first one, unless another is marked default_server
+        std::map<std::string, const ServerBlock*> names; // exact names and "*.suffix" wildcards
     };
 
 private:
 
     std::vector<ServerBlock> _servers;
+    std::vector<Listener> _listeners;
     std::string _configFile;
+    int _workerProcesses;
+    int _workerThreads;
+    int _acceptBudget;
+    int _workerConnections;
+    size_t _clientPoolBufferSize;
+    int _keepAliveWatermark;        // absolute, 0 = derive from the percentage
+    int _keepAliveWatermarkPercent; // of worker_connections
+    size_t _memoryLimit;            // resident bytes, 0 = unlimited
+    int _retryAfter;
+    int _openFileCache;             // entries per event loop, 0 = off
+    int _openFileCacheValid;        // milliseconds
+    size_t _contentCache;           // bytes per process, 0 = off
+    size_t _contentCacheMaxEntry;
+    size_t _compressionCache;       // bytes per process, 0 = off
+    int _threadPool;                // worker pool threads per process, 0 = off
+    int _threadPoolMaxQueue;
 
     void _parseConfigFile(const std::string& filename);
     void _parseServerBlock(std::ifstream& file, ServerBlock& server);
     void _parseLocationBlock(std::ifstream& file, Location& location);
+    void _parseGlobalDirective(const std::string& line);
+    void _buildListeners(bool validate);
+    int _parseWorkerCount(const std::string& directive, const std::vector<std::string>& values);
+    size_t _parseSize(const std::string& directive, const std::vector<std::string>& values);
+    void _parseExpires(const std::vector<std::string>& values, Location& location);
     std::string _parseLine(const std::string& line);
     std::vector<std::string> _parseValues(const std::string& line);
 
@@ -38,6 +74,22 @@ public:
     void loadConfig(const std::string& filename);
     const std::vector<ServerBlock>& getServers() const;
     ServerBlock getDefaultServer() const;
+    const std::vector<Listener>& getListeners() const;
+    int getWorkerProcesses() const;
+    int getWorkerThreads() const;
+    int getAcceptBudget() const;
+    int getWorkerConnections() const;
+    size_t getClientPoolBufferSize() const;
+    int getKeepAliveWatermark() const;
+    size_t getMemoryLimit() const;
+    int getRetryAfter() const;
+    int getOpenFileCache() const;
+    int getOpenFileCacheValid() const;
+    size_t getContentCache() const;
+    size_t getContentCacheMaxEntry() const;
+    size_t getCompressionCache() const;
+    int getThreadPool() const;
+    int getThreadPoolMaxQueue() const;
     
     // Server block access methods
     class ServerIterator {
@@ -66,7 +118,9 @@ public:
     static const std::map<int, std::string>& getErrorPages(const ServerBlock& server);
     static const std::vector<Location>& getLocations(const ServerBlock& server);
     
-    const ServerBlock* findServer(const std::string& host, int port, const std::string& serverName = "") const;
+    // Server block for a request accepted on `listener` (an index into
+    // getListeners()), chosen by its Host header
+    const ServerBlock& findServer(int listener, const std::string& hostHeader) const;
     const Location* findLocation(const ServerBlock& server, const std::string& uri) const;
 };
 
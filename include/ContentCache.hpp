@@ -0,0 +1,81 @@
+#ifndef CONTENTCACHE_HPP
+#define CONTENTCACHE_HPP
+
+#include "webserv.hpp"
+#include "FileCache.hpp"
+#include "SharedBuffer.hpp"
+#include <list>
+#include <pthread.h>
+
+// Contents of static files kept for reuse, one cache per process shared by
+// its event-loop threads behind a mutex (held for lookups and inserts, never
+// while reading a file). Bodies are SharedBuffers: every response, on any
+// loop, queues a reference to the same bytes. Small, hot files are copied
+// into memory, within a byte budget. An entry is only reused while the
+// file's inode, device, size and mtime, as revalidated by the calling
+// loop's FileCache, still match. Least recently used entries go first;
+// evicted content lives on until the last connection sending it is done.
+class ContentCache {
+private:
+    struct Entry {
+        std::string path;
+        SharedBuffer content;
+        ino_t inode;
+        dev_t device;
+        time_t mtime;
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::map<std::string, EntryList::iterator> EntryIndex;
+
+    // One LRU list of entries with its path index
+    struct Store {
+        EntryList entries; // most recently used first
+        EntryIndex index;
+        size_t bytes;
+
+        Store() : bytes(0) {}
+    };
+
+    ContentCache(const ContentCache&);
+    ContentCache& operator=(const ContentCache&);
+
+    pthread_mutex_t _mutex; // guards _copies and the hit/miss/eviction counts
+    Store _copies;
+    size_t _budget;
+    size_t _maxEntrySize;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _evictions;
+
+    static bool _find(Store& store, const FileCache::Entry& file, SharedBuffer& content);
+    static void _insert(Store& store, const FileCache::Entry& file, const SharedBuffer& content);
+    static void _erase(Store& store, EntryList::iterator it);
+    static bool _readFile(const FileCache::Entry& file, std::string& out);
+
+public:
+    ContentCache(size_t budget = CONTENT_CACHE_BUDGET, size_t maxEntrySize = CONTENT_CACHE_MAX_ENTRY);
+    ~ContentCache();
+
+    // Drops every entry
+    void configure(size_t budget, size_t maxEntrySize);
+
+    // Whether `file` (a FileCache entry with an open fd) may be copied in
+    bool accepts(const FileCache::Entry& file) const;
+    // The contents of `file`, read into the cache on a miss. Returns false
+    // when the file is not cacheable or could not be read.
+    bool lookup(const FileCache::Entry& file, SharedBuffer& content);
+    // Whether a file of `size` bytes is small enough to be sent from memory
+    bool holdsInMemory(size_t size) const;
+    // Drops the copy of `path`, after the server itself wrote or removed
+    // it: an overwrite within the same second can keep size and mtime
+    void invalidate(const std::string& path);
+    void clear();
+
+    unsigned long getHits() const;
+    unsigned long getMisses() const;
+    unsigned long getEvictions() const;
+    void logStats();
+};
+
+#endif
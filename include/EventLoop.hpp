@@ -0,0 +1,63 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "webserv.hpp"
+
+// Readiness backend is chosen at build time: epoll on Linux, poll() elsewhere
+// or when built with -DWEBSERV_USE_POLL (make EVENT_BACKEND=poll).
+#if defined(__linux__) && !defined(WEBSERV_USE_POLL)
+# define WEBSERV_HAVE_EPOLL 1
+# include <sys/epoll.h>
+#endif
+
+// Persistent readiness set. File descriptors are registered once and only
+// their interest mask is changed afterwards; wait() reports only the fds that
+// are actually ready. Masks use the POLLIN/POLLOUT/POLLHUP/POLLERR constants
+// regardless of the backend.
+class EventLoop {
+public:
+    struct Event {
+        int fd;
+        short revents;
+    };
+
+private:
+    EventLoop(const EventLoop&);
+    EventLoop& operator=(const EventLoop&);
+
+#ifdef WEBSERV_HAVE_EPOLL
+    int _epollFd;
+    std::vector<struct epoll_event> _epollEvents;
+#else
+    std::vector<struct pollfd> _pollFds;
+    std::vector<int> _pollIndex; // fd -> index into _pollFds, -1 when not watched
+#endif
+    std::vector<short> _interest; // fd -> registered mask, 0 when not watched
+    std::vector<Event> _ready;
+    size_t _watched;
+
+public:
+    EventLoop();
+    ~EventLoop();
+
+    void open();
+    void close();
+    bool isOpen() const;
+
+    // Registration
+    bool add(int fd, short events);
+    bool modify(int fd, short events);
+    void remove(int fd);
+    bool isWatched(int fd) const;
+    short getInterest(int fd) const;
+    size_t size() const;
+
+    // Wait for readiness; returns the number of ready events or -1 on error
+    int wait(int timeoutMs);
+    size_t getReadyCount() const;
+    const Event& getEvent(size_t index) const;
+
+    static const char* getBackendName();
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include "webserv.hpp"
+#include <list>
+
+// Path lookups of the static file path, cached per event loop (not
+// thread-safe: every loop owns its own, like the ClientPool). An entry holds
+// the stat() of a resolved path, or the errno that stat()/open() failed with,
+// its MIME type and, for regular files, an open read-only fd. Entries are
+// trusted for `validMs` after their last stat(); after that the path is
+// stat'ed again and the fd only reopened if the file changed. A failed
+// lookup is never trusted: a missing path is stat'ed again every time, so a
+// file that appears is served at once. The server's own writes drop the
+// entry with invalidate(). The least
+// recently used entry makes room when `capacity` is reached. A capacity of 0
+// disables caching: every lookup goes to the filesystem.
+class FileCache {
+public:
+    struct Entry {
+        std::string path;
+        int error;        // errno of the failed stat()/open(), 0 if found
+        struct stat st;
+        int fd;           // regular files only, -1 until first wanted
+        std::string mimeType;
+        long long checkedAt;
+
+        Entry();
+    };
+
+private:
+    typedef std::list<Entry> EntryList;
+    typedef std::map<std::string, EntryList::iterator> EntryIndex;
+
+    FileCache(const FileCache&);
+    FileCache& operator=(const FileCache&);
+
+    EntryList _entries; // most recently used first
+    EntryIndex _index;
+    Entry _scratch;     // result of an uncached lookup
+    size_t _capacity;
+    long long _validMs;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _revalidations;
+    unsigned long _evictions;
+
+    void _load(Entry& entry, const std::string& path);
+    void _stat(Entry& entry);
+    void _open(Entry& entry);
+    static void _closeFd(Entry& entry);
+
+public:
+    FileCache(size_t capacity = OPEN_FILE_CACHE_ENTRIES, long long validMs = OPEN_FILE_CACHE_VALID_MS);
+    ~FileCache();
+
+    // Drops every entry
+    void configure(size_t capacity, long long validMs);
+
+    // The entry for `path`; the reference is only good until the next
+    // lookup. With `wantFd` a regular file is opened if it is not already.
+    const Entry& lookup(const std::string& path, bool wantFd);
+    // Forgets `path`, after the server itself wrote or removed it
+    void invalidate(const std::string& path);
+    void clear();
+
+    unsigned long getHits() const;
+    unsigned long getMisses() const;
+    void logStats() const;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef HANDOFFQUEUE_HPP
+#define HANDOFFQUEUE_HPP
+
+#include "webserv.hpp"
+
+// Single-producer / single-consumer queue used to pass accepted client fds,
+// with the listener each came in on, from the acceptor thread to an
+// event-loop thread. push() and pop() never
+// block or take a lock; the consumer watches getWakeFd() in its event loop
+// (an eventfd on Linux, a pipe elsewhere) and is woken by notify().
+class HandoffQueue {
+private:
+    HandoffQueue(const HandoffQueue&);
+    HandoffQueue& operator=(const HandoffQueue&);
+
+    struct Slot {
+        int fd;
+        int listener;
+    };
+
+    std::vector<Slot> _slots;
+    size_t _mask;
+    volatile size_t _head; // next slot to pop, written by the consumer only
+    volatile size_t _tail; // next slot to push, written by the producer only
+    int _wakeReadFd;
+    int _wakeWriteFd;
+
+public:
+    explicit HandoffQueue(size_t capacity = 4096);
+    ~HandoffQueue();
+
+    // Producer side
+    bool push(int fd, int listener);
+    void notify();
+
+    // Consumer side
+    bool pop(int& fd, int& listener);
+    void drainWakeups();
+    int getWakeFd() const;
+
+    size_t size() const;
+};
+
+#endif
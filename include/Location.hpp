@@ -2,8 +2,13 @@
 #define LOCATION_HPP
 
 #include "webserv.hpp"
+#include "Compression.hpp"
 
 class Location {
+public:
+    // Extra headers of static responses, rendered once when the config loads
+    typedef std::vector<std::pair<std::string, std::string> > HeaderList;
+
 private:
     std::string _path;
     std::string _root;
@@ -15,6 +20,9 @@ private:
     std::string _cgiPath;
     std::string _cgiExtension;
     size_t _maxBodySize;
+    bool _gzipStatic;
+    Compression::Settings _compression;
+    HeaderList _responseHeaders;
 
 public:
     Location();
@@ -34,6 +42,9 @@ public:
     const std::string& getCgiPath() const;
     const std::string& getCgiExtension() const;
     size_t getMaxBodySize() const;
+    bool getGzipStatic() const;
+    const Compression::Settings& getCompression() const;
+    const HeaderList& getResponseHeaders() const;
 
     // Setters
     void setPath(const std::string& path);
@@ -47,6 +58,13 @@ public:
     void setCgiPath(const std::string& cgiPath);
     void setCgiExtension(const std::string& cgiExtension);
     void setMaxBodySize(size_t maxBodySize);
+    void setGzipStatic(bool gzipStatic);
+    void setCompressionLevel(int level);
+    void setCompressionMinLength(size_t minLength);
+    void setCompressionTypes(const std::vector<std::string>& types);
+    // Replaces a header of the same name (case-insensitive) if already set
+    void setResponseHeader(const std::string& name, const std::string& value);
+    void removeResponseHeader(const std::string& name);
 
     // Methods
     bool isMethodAllowed(const std::string& method) const;
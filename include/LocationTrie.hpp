@@ -0,0 +1,46 @@
+#ifndef LOCATIONTRIE_HPP
+#define LOCATIONTRIE_HPP
+
+#include "webserv.hpp"
+#include "Location.hpp"
+
+// Longest-prefix index over the locations of a server block, compiled once
+// when the configuration is loaded. Paths are stored byte by byte in a trie
+// flattened into two arrays (nodes, and each node's outgoing edges sorted by
+// byte), so a lookup is one walk along the URI with a binary search per
+// byte and no allocation. Matching follows Location::matches(): a path only
+// matches at a segment boundary, "/" matches everything, and of two
+// locations with the same path the first one wins.
+//
+// Nodes refer to locations by index, so the trie stays valid when its
+// server block is copied along with the locations it was built from.
+class LocationTrie {
+public:
+    static const int NONE = -1;
+
+private:
+    struct Node {
+        size_t firstEdge;
+        size_t edgeCount;
+        int location; // index of the location whose path ends here, or NONE
+    };
+
+    struct Edge {
+        unsigned char byte;
+        size_t child;
+    };
+
+    std::vector<Node> _nodes; // _nodes[0] is the empty prefix
+    std::vector<Edge> _edges;
+    int _catchAll;            // the "/" location
+
+public:
+    LocationTrie();
+
+    void build(const std::vector<Location>& locations);
+    // Index of the longest location matching `uri`, or NONE
+    int match(const std::string& uri) const;
+    size_t size() const;
+};
+
+#endif
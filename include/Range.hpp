@@ -16,6 +16,7 @@ class Range {
 private:
     std::vector<ByteRange> _ranges;
     size_t _contentLength;
+    std::string _boundary; // multipart/byteranges separator, set for multi-range
 
 public:
     Range();
@@ -40,9 +41,16 @@ public:
     // Content generation
     std::string extractRange(const std::string& content, const ByteRange& range) const;
     std::string generateMultipartBody(const std::string& content, const std::string& contentType) const;
+    // multipart/byteranges framing, for bodies whose parts are sent from
+    // elsewhere (file regions): each part's header, then the closing trailer
+    std::string generatePartHeader(const ByteRange& range, const std::string& contentType) const;
+    std::string generateMultipartTrailer() const;
+    std::string getMultipartContentType() const;
     
     // Response headers
     std::string generateContentRangeHeader(const ByteRange& range) const;
+    // Content-Range of a 416 response: "bytes */<length>"
+    std::string generateUnsatisfiedRangeHeader() const;
     std::string generateContentLengthHeader(const ByteRange& range) const;
     
     // Static utilities
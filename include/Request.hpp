@@ -67,6 +67,8 @@ public:
     bool isChunked() const;
     bool isStreamingMode() const;
     bool hasChunkedTimeout(int timeoutSeconds = 60) const;  // Check if chunked upload has timed out
+    time_t getChunkStartTime() const;
+    bool hasPendingHeaders() const;  // A request has started but its headers are not complete yet
     // Memory management helpers for large bodies (used by CGI streaming)
     void discardBodyPrefix(size_t n);
     size_t getStoredBodySize() const { return _body.size(); }
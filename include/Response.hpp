@@ -3,15 +3,41 @@
 
 #include "webserv.hpp"
 #include "Cookie.hpp"
+#include "SharedBuffer.hpp"
 
 class Response {
+public:
+    // Slice of a file or shared body preceded by its framing, for bodies
+    // sent as several parts (multipart/byteranges)
+    struct BodyPart {
+        std::string header;
+        size_t offset; // into the file or shared body
+        size_t length;
+    };
+
 private:
+    // Open file behind a file-backed body, shared by copies of the Response
+    struct FileBody {
+        int fd;
+        int refs;
+    };
+
     int _statusCode;
     std::string _statusMessage;
     Headers _headers;
     std::string _body;
     bool _isComplete;
     size_t _bytesSent;
+    SharedBuffer _sharedBody; // the body instead of `_body` when set
+    size_t _sharedOffset;     // slice of `_sharedBody` that is sent
+    size_t _sharedLength;
+    FileBody* _file;
+    off_t _fileOffset;
+    size_t _fileLength;
+    std::vector<BodyPart> _parts; // when set, the body is these parts of the file or shared body
+    std::string _partsTrailer;    // followed by this
+
+    void _releaseFile();
 
 public:
     Response();
@@ -23,11 +49,29 @@ public:
     // Setters
     void setStatusCode(int statusCode);
     void setHeader(const std::string& name, const std::string& value);
+    void removeHeader(const std::string& name);
     void setBody(const std::string& body);
     void setBody(const char* data, size_t length);
     void appendBody(const std::string& data);
+    // Moves the body into `out` (no copy); headers, Content-Length included, stay
+    void releaseBody(std::string& out);
+    // Body referencing shared immutable bytes (cached content), not copied
+    void setSharedBody(const SharedBuffer& body);
+    // Narrow the shared body to a slice (used for byte ranges)
+    void setSharedRange(size_t offset, size_t length);
     void setComplete(bool complete);
 
+    // File-backed body: `length` bytes of `fd` starting at `offset` are sent
+    // straight from the file. The response takes ownership of `fd`.
+    void setFileBody(int fd, off_t offset, size_t length);
+    // Narrow the file region (used for byte ranges)
+    void setFileRange(off_t offset, size_t length);
+    // Send the file or shared body as `parts` followed by `trailer` instead
+    // of a single region
+    void setBodyParts(const std::vector<BodyPart>& parts, const std::string& trailer);
+    // Hands the file over to the caller (dup'ed if a copy still shares it)
+    int detachFile(off_t& offset, size_t& length);
+
     // Cookie support (BONUS)
     void setCookie(const Cookie& cookie);
     void addCookie(const Cookie& cookie);
@@ -36,7 +80,10 @@ public:
     int getStatusCode() const;
     const std::string& getStatusMessage() const;
     const Headers& getHeaders() const;
+    // In-memory string body; empty for shared and file-backed bodies
     const std::string& getBody() const;
+    // Bytes of a string or shared body (NULL for a file-backed or multipart one)
+    const char* getBodyData(size_t& length) const;
     std::string getHeader(const std::string& name) const;
     bool hasHeader(const std::string& name) const;
     // Case-insensitive header access (for CGI header handling etc.)
@@ -45,8 +92,16 @@ public:
     bool isComplete() const;
     size_t getBytesSent() const;
     size_t getContentLength() const;
+    bool hasSharedBody() const;
+    const SharedBuffer& getSharedBody() const;
+    size_t getSharedOffset() const;
+    bool hasFileBody() const;
+    off_t getFileOffset() const;
+    size_t getFileLength() const;
+    const std::vector<BodyPart>& getBodyParts() const;
+    const std::string& getBodyPartsTrailer() const;
 
-    // Build response
+    // Build response (a file-backed body is never part of the string)
     std::string toString(bool includeBody = true) const;
     void reset();
     void addDefaultHeaders();
@@ -55,6 +110,11 @@ public:
     static Response createErrorResponse(int statusCode, const std::string& errorPage = "");
     static Response createRedirectResponse(int statusCode, const std::string& location);
     static Response createFileResponse(const std::string& filename, const std::string& mimeType = "");
+    // Status line, entity headers and validators of a file from its stat
+    // data alone: no body, the file is never opened (HEAD, 304 and the like)
+    static Response createFileMetadataResponse(const struct stat& st, const std::string& mimeType);
+    // Weak entity tag of a file, derived from its inode, size and mtime
+    static std::string makeETag(const struct stat& st);
     static Response createDirectoryListingResponse(const std::string& path, const std::string& uri);
 
     // Send tracking
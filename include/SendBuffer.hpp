@@ -0,0 +1,90 @@
+#ifndef SENDBUFFER_HPP
+#define SENDBUFFER_HPP
+
+#include "webserv.hpp"
+#include "SharedBuffer.hpp"
+#include <deque>
+#include <sys/uio.h>
+
+// Outgoing byte queue of a connection. Data is kept as a chain of chunks,
+// each with its own read offset: consuming sent bytes only advances the
+// offset of the front chunk (O(1), no memmove of what is left), and appends
+// go to the tail chunk or a fresh one. Drained chunks keep their storage in
+// a small spare list so a busy connection stops allocating.
+//
+// A chunk can also reference a SharedBuffer (appendShared), so cached
+// content is queued on many connections without being copied, or be a
+// region of an open file (appendFile): the latter counts
+// towards size() like any other bytes but is never loaded into memory; the
+// owner sends it with sendfile() once it reaches the front of the queue.
+class SendBuffer {
+public:
+    static const size_t CHUNK_SIZE = 65536; // small appends coalesce up to this
+    static const size_t MAX_SPARE_CHUNKS = 4;
+
+private:
+    struct Chunk {
+        std::string data;
+        SharedBuffer shared; // referenced bytes, used instead of `data` when set
+        size_t offset;       // bytes of the chunk already consumed
+        size_t end;          // end of the referenced slice of `shared`
+        int fileFd;          // -1 unless this chunk is a file region (owned)
+        off_t fileOffset;
+        size_t fileRemaining;
+
+        Chunk() : offset(0), end(0), fileFd(-1), fileOffset(0), fileRemaining(0) {}
+        const char* bytes() const { return shared.isNull() ? data.data() : shared.data(); }
+        size_t limit() const { return shared.isNull() ? data.size() : end; }
+        size_t available() const { return fileFd >= 0 ? fileRemaining : limit() - offset; }
+        bool isOwnedMemory() const { return fileFd < 0 && shared.isNull(); }
+    };
+
+    std::deque<Chunk> _chunks;
+    std::vector<std::string> _spare;
+    size_t _size;
+
+    Chunk& _pushChunk();
+    void _popChunk();
+
+public:
+    SendBuffer();
+    SendBuffer(const SendBuffer& other);
+    SendBuffer& operator=(const SendBuffer& other);
+    ~SendBuffer();
+
+    bool empty() const;
+    size_t size() const;
+
+    void append(const char* data, size_t length);
+    void append(const std::string& data);
+    // Takes over the contents of `data` without copying; `data` is left empty
+    void appendOwned(std::string& data);
+    void prepend(const std::string& data);
+    // Queue a reference to `length` bytes of `data` from byte `offset`
+    void appendShared(const SharedBuffer& data, size_t offset = 0, size_t length = std::string::npos);
+    // Queue `length` bytes of `fd` from `offset`; the buffer takes ownership
+    // of `fd` and closes it once the region is consumed or cleared
+    void appendFile(int fd, off_t offset, size_t length);
+
+    // Contiguous bytes at the front of the queue, for send()
+    const char* frontData() const;
+    size_t frontSize() const;
+    // Describe up to `maxCount` leading in-memory chunks for writev()/
+    // sendmsg(), stopping at the first file region; returns the number of
+    // entries filled. `fileFollows` tells whether a file region comes next.
+    size_t fillIovec(struct iovec* iov, size_t maxCount, bool* fileFollows = NULL) const;
+    // The file region at the front of the queue, if any
+    bool frontFile(int& fd, off_t& offset, size_t& length) const;
+    void consume(size_t length);
+
+    // Inspection only covers the in-memory bytes before any file region
+    bool startsWith(const std::string& prefix) const;
+    bool contains(const std::string& needle) const;
+    std::string str() const;
+
+    void clear();
+    // Release storage beyond `maxCapacity` bytes (used when pooling clients)
+    void trim(size_t maxCapacity);
+};
+
+#endif
@@ -4,27 +4,131 @@
 #include "webserv.hpp"
 #include "Config.hpp"
 #include "Client.hpp"
+#include "EventLoop.hpp"
+#include "HandoffQueue.hpp"
+#include "TimerWheel.hpp"
+#include "ClientPool.hpp"
+#include "FileCache.hpp"
+#include "ContentCache.hpp"
+#include "VariantCache.hpp"
+#include "WorkerPool.hpp"
+#include <pthread.h>
 
 class Server {
 private:
+    // Role of a registered fd, used to dispatch ready events directly
+    enum FdRole {
+        FD_NONE,
+        FD_LISTENER,
+        FD_CLIENT,
+        FD_CGI_STDIN,
+        FD_CGI_STDOUT,
+        FD_WAKEUP,
+        FD_COMPLETION
+    };
+
+    // Dense fd-indexed dispatch entry. For FD_CLIENT slots, cgiStdin and
+    // cgiStdout record the CGI pipe fds currently registered for that client;
+    // FD_LISTENER slots record their index into Config::getListeners().
+    struct FdSlot {
+        FdRole role;
+        Client* client;
+        int cgiStdin;
+        int cgiStdout;
+        int listener;
+    };
+
     Config _config;
     std::vector<int> _serverSockets;
-    std::map<int, Client*> _clients;
-    std::vector<struct pollfd> _pollFds;
-    bool _running;
+    int _acceptBudget;
+
+    // Accept statistics: connections taken per listener wakeup
+    unsigned long _acceptWakeups;
+    unsigned long _acceptedTotal;
+    size_t _maxAcceptsPerWakeup;
+    unsigned long _acceptBudgetExhausted;
+    std::vector<FdSlot> _fdTable;
+    ClientPool _clientPool;
+    FileCache _fileCache;
+    ContentCache _contentCache;
+    VariantCache _variantCache;
+    WorkerPool _workerPool;
+    WorkerPool::CompletionQueue _completions; // our jobs the pool has finished
+
+    // Admission control: hard connection and memory limits answered with a
+    // canned 503, and a soft watermark above which keep-alive is refused
+    int _workerConnections;
+    int _keepAliveWatermark;
+    size_t _memoryLimit;
+    size_t _residentMemory;
+    long long _memorySampledAtMs;
+    unsigned long _shedConnections;
+    std::string _overloadResponse;
+    size_t _clientCount; // changed atomically: the acceptor reads it to balance load
+    EventLoop _loop;
+    TimerWheel _timers;
+    std::vector<TimerWheel::Timer*> _expiredTimers;
+    volatile bool _running;
+
+    // Multi-process mode: the master only supervises, workers serve
+    int _workerProcesses;
+    bool _isWorker;
+    std::vector<pid_t> _workers;
+    std::vector<time_t> _workerStartTimes;
+
+    // Threaded mode: this Server only accepts and hands each connection to
+    // one of its loop-thread Servers, which own disjoint sets of clients
+    int _workerThreads;
+    std::vector<Server*> _loopThreads;
+    HandoffQueue* _handoff; // inbound connections, loop-thread Servers only
+    ContentCache* _contents; // our _contentCache, or the acceptor's for a loop thread
+    VariantCache* _variants; // our _variantCache, or the acceptor's for a loop thread
+    WorkerPool* _offload;    // likewise our _workerPool, NULL when it is off
+    pthread_t _thread;
     
     // Socket management
     int _createServerSocket(const std::string& host, int port);
     void _setupServerSockets();
-    void _acceptNewConnection(int serverSocket);
+    void _acceptNewConnection(int serverSocket, int listener);
+    void _recordAcceptBatch(size_t accepted);
+    bool _isOverloaded(size_t activeClients);
+    void _rejectOverloaded(int clientSocket);
+    void _logAcceptStats() const;
+    void _adoptClient(int clientSocket, int listener);
     void _closeClient(int clientFd);
     
-    // Poll management
-    void _updatePollFds();
+    // Event loop management
+    FdSlot* _getSlot(int fd);
+    void _bindSlot(int fd, FdRole role, Client* client);
+    void _releaseSlot(int fd);
+    void _watch(int fd, short events);
+    void _watchCgiPipe(Client* client, int& registeredFd, int fd, FdRole role, short events);
+    void _updateInterest(Client* client);
+    void _unwatchClient(int clientFd);
     void _handlePollEvents();
+    void _handleClientEvent(Client* client, short revents);
     void _handleClientRead(int clientFd);
     void _handleClientWrite(int clientFd);
-    void _checkCgiCompletion();
+    void _checkCgiCompletion(Client* client);
+    void _openCompletions();
+    void _finishJobs();
+    void _eventLoop();
+
+    // Worker process supervision
+    void _installSignalHandlers();
+    void _superviseWorkers();
+    bool _spawnWorker(size_t slot);
+    void _stopWorkers();
+
+    // Event-loop threads
+    void _startServing();
+    void _startLoopThreads();
+    void _stopLoopThreads();
+    void _handOff(int clientSocket, int listener);
+    void _adoptHandedOffClients();
+    size_t _getLoad();
+    static void* _loopThreadMain(void* arg);
+    void _logPendingSignal();
     
     // Request processing
     void _processClientRequest(Client& client);
@@ -43,6 +147,11 @@ private:
     void _handleTimeout();
     void _cleanup();
 
+    // Client timeouts
+    void _updateTimers(Client* client);
+    void _cancelTimers(Client* client);
+    bool _isIdleExpired(Client* client);
+
 public:
     Server();
     Server(const std::string& configFile);
@@ -62,6 +171,11 @@ public:
     static void signalHandler(int signal);
     static Server* instance;
 private:
+    static volatile sig_atomic_t _pendingSignal;
+
+    // Loop-thread Server with its own read-only copy of the configuration
+    explicit Server(const Config& config);
+
     // Non-copyable
     Server(const Server& other);
     Server& operator=(const Server& other);
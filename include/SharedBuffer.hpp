@@ -0,0 +1,34 @@
+#ifndef SHAREDBUFFER_HPP
+#define SHAREDBUFFER_HPP
+
+#include "webserv.hpp"
+
+// Immutable bytes shared by reference count: one copy of cached content can
+// be queued on any number of connections. The count is atomic because the
+// last reference may be dropped on a different loop thread than the first.
+class SharedBuffer {
+private:
+    struct Block {
+        std::string data;
+        int refs;
+    };
+
+    Block* _block;
+
+    void _release();
+
+public:
+    SharedBuffer();
+    // Takes over the contents of `data` without copying; `data` is left empty
+    explicit SharedBuffer(std::string& data);
+    SharedBuffer(const SharedBuffer& other);
+    SharedBuffer& operator=(const SharedBuffer& other);
+    ~SharedBuffer();
+
+    bool isNull() const;
+    const char* data() const;
+    size_t size() const;
+    void reset();
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include "webserv.hpp"
+
+// Hierarchical timer wheel (four levels of 64 slots, 10 ms ticks) keyed on
+// the cached monotonic clock from Utils::nowMs(). Timers are intrusive nodes
+// owned by the caller: arming, re-arming and cancelling are O(1), and
+// advance() only touches the timers that actually expire (plus an amortized
+// cascade of the coarser levels).
+class TimerWheel {
+public:
+    static const long long TICK_MS = 10;
+
+    struct Timer {
+        Timer* prev;
+        Timer* next;
+        long long expires; // absolute tick
+        void* owner;
+        int kind;
+
+        Timer();
+        // Copies start out unarmed: list links are never shared
+        Timer(const Timer& other);
+        Timer& operator=(const Timer& other);
+
+        bool isArmed() const;
+    };
+
+private:
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    Timer _slots[LEVELS][SLOTS]; // circular list heads
+    long long _current;          // next tick to be processed
+    size_t _armed;
+
+    void _insert(Timer& timer);
+    void _unlink(Timer& timer);
+    bool _cascade(int level, int index);
+
+public:
+    TimerWheel();
+    ~TimerWheel();
+
+    void schedule(Timer& timer, long long deadlineMs);
+    void cancel(Timer& timer);
+
+    // Collect every timer due at `nowMs`; returned timers are unarmed
+    void advance(long long nowMs, std::vector<Timer*>& expired);
+
+    // Milliseconds until the wheel next needs advancing, or -1 when idle
+    int nextTimeoutMs(long long nowMs) const;
+    size_t size() const;
+};
+
+#endif
@@ -10,6 +10,7 @@ public:
     static std::string toLowerCase(const std::string& str);
     static std::string toUpperCase(const std::string& str);
     static std::string intToString(int value);
+    static std::string sizeToString(size_t value);
     static int stringToInt(const std::string& str);
     static size_t stringToSize(const std::string& str);
     static bool isNumber(const std::string& str);
@@ -26,7 +27,16 @@ public:
     static std::string generateDirectoryListing(const std::string& path, const std::string& uri);
     static size_t hexToSize(const std::string& hex);
     static std::string getCurrentTime();
+    static std::string formatHttpDate(time_t when);
+    static bool parseHttpDate(const std::string& value, time_t& when);
+    // Cached monotonic clock, refreshed once per event-loop iteration
+    static void updateClock();
+    static long long nowMs();
+    static time_t now();
+    static size_t getResidentMemory(); // bytes, 0 when unknown
+    static unsigned long long threadCpuMicros(); // CPU time of the calling thread
     static void setNonBlocking(int fd);
+    static void setCloseOnExec(int fd);
     static bool dechunk(const std::string& in, std::string& out); // make static
 };
 
@@ -0,0 +1,71 @@
+#ifndef VARIANTCACHE_HPP
+#define VARIANTCACHE_HPP
+
+#include "webserv.hpp"
+#include "SharedBuffer.hpp"
+#include <list>
+#include <set>
+#include <pthread.h>
+
+// Compressed variants of response bodies, shared by all event-loop threads
+// of a process. A key names the source bytes and the encoding: for a
+// static file its resolved path and entity tag (inode, size and mtime), so
+// a changed file simply stops being hit and ages out. Least recently used
+// variants go first, within a byte budget.
+//
+// The first thread to miss a key owns it and must store() or abandon() it.
+// Threads missing the same key meanwhile never wait for that result (they
+// run event loops): they compress their own copy, which is not stored.
+class VariantCache {
+private:
+    struct Entry {
+        std::string key;
+        SharedBuffer variant;
+        unsigned long long cpuMicros; // spent compressing it, saved by every hit
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::map<std::string, EntryList::iterator> EntryIndex;
+
+    VariantCache(const VariantCache&);
+    VariantCache& operator=(const VariantCache&);
+
+    pthread_mutex_t _mutex;
+    EntryList _entries;      // most recently used first
+    EntryIndex _index;
+    std::set<std::string> _pending;
+    size_t _bytes;
+    size_t _budget;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _concurrent; // misses on a key being made elsewhere
+    unsigned long _evictions;
+    unsigned long long _savedMicros;
+
+    void _erase(EntryList::iterator it);
+
+public:
+    explicit VariantCache(size_t budget = VARIANT_CACHE_BUDGET);
+    ~VariantCache();
+
+    // Drops every entry
+    void configure(size_t budget);
+    bool isEnabled() const;
+
+    // True with `variant` set on a hit. False on a miss, with `owner` telling
+    // whether the caller now owns the key and must store() or abandon() it
+    // (false: it is being made elsewhere). Never waits.
+    bool acquire(const std::string& key, SharedBuffer& variant, bool& owner);
+    // The variant under `key` if cached, without counting a hit
+    bool peek(const std::string& key, SharedBuffer& variant);
+    // `cpuMicros` is the CPU time the compression took
+    void store(const std::string& key, const SharedBuffer& variant, unsigned long long cpuMicros);
+    void abandon(const std::string& key);
+    void clear();
+
+    // Compression CPU time hits have not had to spend
+    unsigned long long getSavedMicros() const;
+    void logStats();
+};
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include "webserv.hpp"
+#include <deque>
+#include <pthread.h>
+
+// Bounded pool of threads for CPU-heavy work that would otherwise stall an
+// event loop (compressing large bodies). A loop submits a Job together with
+// the CompletionQueue it watches; a worker runs the job and hands it back
+// through that queue, whose eventfd wakes the loop, and the loop finishes
+// and deletes it. A job is only ever touched by one thread at a time.
+//
+// Submitting never blocks: when the queue is full the caller does the work
+// itself, which also keeps the latency of a queued job bounded.
+class WorkerPool {
+public:
+    class Job {
+    public:
+        void* owner;                    // set by the submitter, NULL once cancelled
+        unsigned long long submittedAt; // monotonic microseconds
+        unsigned long long startedAt;
+        unsigned long long finishedAt;
+        bool ran;                       // false if the pool stopped before running it
+
+        Job();
+        virtual ~Job();
+        virtual void run() = 0; // on a worker thread
+    };
+
+    // Finished jobs of one event loop
+    class CompletionQueue {
+    private:
+        CompletionQueue(const CompletionQueue&);
+        CompletionQueue& operator=(const CompletionQueue&);
+
+        pthread_mutex_t _mutex;
+        std::vector<Job*> _done;
+        int _wakeReadFd;
+        int _wakeWriteFd;
+
+    public:
+        CompletionQueue();
+        ~CompletionQueue();
+
+        // Opened by the serving process (after fork) so the fd is its own
+        void open();
+        void close();
+        bool isOpen() const;
+        int getWakeFd() const;
+
+        void push(Job* job);               // worker side; wakes the loop
+        void drain(std::vector<Job*>& out); // loop side
+    };
+
+private:
+    struct Entry {
+        Job* job;
+        CompletionQueue* completions;
+    };
+
+    WorkerPool(const WorkerPool&);
+    WorkerPool& operator=(const WorkerPool&);
+
+    pthread_mutex_t _mutex;
+    pthread_cond_t _ready; // a job was queued, or the pool is stopping
+    std::deque<Entry> _queue;
+    std::vector<pthread_t> _threads;
+    size_t _maxQueue;
+    bool _stopping;
+
+    // Metrics, under _mutex
+    unsigned long _submitted;
+    unsigned long _rejected;
+    unsigned long _completed;
+    unsigned long long _depthTotal; // queue depth seen by each submit
+    size_t _maxDepth;
+    unsigned long long _waitMicros;
+    unsigned long long _maxWaitMicros;
+    unsigned long long _runMicros;
+    unsigned long long _maxRunMicros;
+
+    static void* _threadMain(void* arg);
+    void _work();
+
+public:
+    WorkerPool();
+    ~WorkerPool();
+
+    // Starts `threads` workers with room for `maxQueue` waiting jobs
+    void start(size_t threads, size_t maxQueue);
+    // Joins the workers; jobs still queued go back to their loops unrun
+    void stop();
+    bool isRunning() const;
+
+    // False when the pool is stopped or its queue is full
+    bool submit(Job* job, CompletionQueue* completions);
+    size_t getQueueDepth();
+
+    static unsigned long long nowMicros();
+    void logStats();
+};
+
+#endif
@@ -37,7 +37,18 @@
 
 // Project Constants
 #define BUFFER_SIZE 65536  // 64KB for better performance
-#define MAX_CLIENTS 1024
+#define MAX_CLIENTS 1024  // default worker_connections
+#define ACCEPT_BUDGET 64  // connections accepted per listener wakeup
+#define KEEPALIVE_WATERMARK_PERCENT 90  // of worker_connections
+#define RETRY_AFTER_SECONDS 5  // advertised in overload 503s
+#define OPEN_FILE_CACHE_ENTRIES 256  // cached path lookups per event loop
+#define OPEN_FILE_CACHE_VALID_MS 1000  // before a cached lookup is re-stat'ed
+#define CONTENT_CACHE_BUDGET 16777216  // 16MB of hot file contents per process
+#define CONTENT_CACHE_MAX_ENTRY 262144  // larger files are sent with sendfile()
+#define VARIANT_CACHE_BUDGET 16777216  // 16MB of compressed bodies per process
+#define GZIP_MIN_LENGTH 100  // smaller bodies are not worth compressing
+#define THREAD_POOL_THREADS 2  // per process, for compressing large bodies
+#define THREAD_POOL_MAX_QUEUE 256  // jobs waiting for a pool thread
 #define MAX_BODY_SIZE 209715200  // 200MB default
 #define HTTP_VERSION "HTTP/1.1"
 #define SERVER_NAME "webserv/1.0"
@@ -46,14 +57,17 @@
 #define HTTP_OK 200
 #define HTTP_CREATED 201
 #define HTTP_NO_CONTENT 204
+#define HTTP_PARTIAL_CONTENT 206
 #define HTTP_MOVED_PERMANENTLY 301
 #define HTTP_FOUND 302
+#define HTTP_NOT_MODIFIED 304
 #define HTTP_BAD_REQUEST 400
 #define HTTP_FORBIDDEN 403
 #define HTTP_NOT_FOUND 404
 #define HTTP_METHOD_NOT_ALLOWED 405
 #define HTTP_REQUEST_TIMEOUT 408
 #define HTTP_PAYLOAD_TOO_LARGE 413
+#define HTTP_RANGE_NOT_SATISFIABLE 416
 #define HTTP_INTERNAL_SERVER_ERROR 500
 #define HTTP_NOT_IMPLEMENTED 501
 #define HTTP_BAD_GATEWAY 502
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Compression round trip: serves generated text files with gzip and checks
+# that each body gunzips back to the file. One file is small enough to be
+# compressed whole, the other large enough to be compressed as it streams
+# (chunked). Random base64 is used so the compressor emits output on almost
+# every block, including the last one.
+# Usage: ./scripts/compression_roundtrip.sh [port]
+
+ROOT_DIR="$(cd "$(dirname "$0")/.." && pwd)"
+WEBSERV_BIN="$ROOT_DIR/webserv"
+PORT=${1:-18180}
+WORK_DIR="$(mktemp -d)"
+trap 'kill $SERVER_PID 2>/dev/null; wait $SERVER_PID 2>/dev/null; rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -x "$WEBSERV_BIN" ]; then
+  echo "Error: webserv binary not found or not executable: $WEBSERV_BIN"
+  exit 1
+fi
+
+mkdir -p "$WORK_DIR/www"
+head -c 30000 /dev/urandom | base64 > "$WORK_DIR/www/small.txt"
+head -c 3000000 /dev/urandom | base64 > "$WORK_DIR/www/large.txt"
+
+cat > "$WORK_DIR/roundtrip.conf" <<EOF
+server {
+    listen 127.0.0.1:$PORT;
+    root $WORK_DIR/www;
+    location / {
+        root $WORK_DIR/www;
+        allow_methods GET HEAD;
+    }
+}
+EOF
+
+"$WEBSERV_BIN" "$WORK_DIR/roundtrip.conf" > "$WORK_DIR/webserv.log" 2>&1 &
+SERVER_PID=$!
+for _ in $(seq 50); do
+  curl -s -o /dev/null "http://127.0.0.1:$PORT/" && break
+  sleep 0.1
+done
+
+failures=0
+for name in small large; do
+  file="$WORK_DIR/www/$name.txt"
+  headers="$WORK_DIR/$name.headers"
+  curl -s -D "$headers" -o "$WORK_DIR/$name.gz" -H "Accept-Encoding: gzip" "http://127.0.0.1:$PORT/$name.txt"
+  if ! grep -qi "^content-encoding: gzip" "$headers"; then
+    echo "FAIL $name.txt: not compressed"
+    failures=$((failures + 1))
+  elif ! gunzip -c "$WORK_DIR/$name.gz" 2>/dev/null | cmp -s - "$file"; then
+    echo "FAIL $name.txt: body does not gunzip back to the file"
+    failures=$((failures + 1))
+  else
+    framing=$(grep -qi "^transfer-encoding: chunked" "$headers" && echo streamed || echo whole)
+    echo "ok   $name.txt ($framing)"
+  fi
+done
+
+exit $failures
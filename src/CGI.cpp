@@ -128,6 +128,12 @@ bool CGI::execute(const Request& request, const std::string& scriptPath) {
         Logger::error("CGI: pipe() failed");
         return false;
     }
+    // Keep every pipe end out of other CGI children; dup2() onto stdin/stdout
+    // clears the flag for the ends this child actually uses.
+    for (int i = 0; i < 2; ++i) {
+        Utils::setCloseOnExec(inPipe[i]);
+        Utils::setCloseOnExec(outPipe[i]);
+    }
 
     // Build environment (already forwards all headers as HTTP_* via _setupEnvironment)
     _setupEnvironment(request);
@@ -159,6 +165,25 @@ bool CGI::execute(const Request& request, const std::string& scriptPath) {
         return false;
     }
 
+    // Build argv before fork(): with worker_threads another thread may hold
+    // the allocator lock at fork time, so the child must not allocate.
+    std::string interp;
+    std::vector<char*> argv;
+    if (isMappedBla) {
+        argv.push_back(const_cast<char*>(handlerAbs.c_str()));
+        // Pass the target script path as first argument to the handler
+        argv.push_back(const_cast<char*>(scriptPath.c_str()));
+    } else {
+        interp = getCgiInterpreter(scriptPath);
+        if (!interp.empty()) {
+            argv.push_back(const_cast<char*>(interp.c_str()));
+            argv.push_back(const_cast<char*>(scriptPath.c_str())); // use full path
+        } else {
+            argv.push_back(const_cast<char*>(scriptPath.c_str())); // execute script directly
+        }
+    }
+    argv.push_back(NULL);
+
     _pid = fork();
     if (_pid == -1) {
         Logger::error("CGI: fork() failed");
@@ -177,22 +202,6 @@ bool CGI::execute(const Request& request, const std::string& scriptPath) {
         int devnull = open("/dev/null", O_WRONLY);
         if (devnull != -1) { dup2(devnull, STDERR_FILENO); close(devnull); }
 
-        std::vector<char*> argv;
-        if (isMappedBla) {
-            argv.push_back(const_cast<char*>(handlerAbs.c_str()));
-            // Pass the target script path as first argument to the handler
-            argv.push_back(const_cast<char*>(scriptPath.c_str()));
-        } else {
-            std::string interp = getCgiInterpreter(scriptPath);
-            if (!interp.empty()) {
-                argv.push_back(const_cast<char*>(interp.c_str()));
-                argv.push_back(const_cast<char*>(scriptPath.c_str())); // use full path
-            } else {
-                argv.push_back(const_cast<char*>(scriptPath.c_str())); // execute script directly
-            }
-        }
-        argv.push_back(NULL);
-
         // execve program is argv[0]
         execve(argv[0], &argv[0], envArray);
         _exit(127);
@@ -205,7 +214,7 @@ bool CGI::execute(const Request& request, const std::string& scriptPath) {
     fcntl(_outputFd, F_SETFL, O_NONBLOCK);
 
     _isRunning      = true;
-    _startTime      = time(NULL);
+    _startTime      = Utils::now();
     _lastOutputTime = _startTime;
     _totalBytesRead = 0;
 
@@ -282,7 +291,7 @@ bool CGI::hasTimedOut(int timeoutSeconds) const {
     // Use _lastOutputTime as last activity marker; if it's not set, fall back to _startTime.
     time_t lastActivity = _lastOutputTime;
     if (lastActivity == 0) lastActivity = _startTime;
-    return (time(NULL) - lastActivity) > timeoutSeconds;
+    return (Utils::now() - lastActivity) > timeoutSeconds;
 }
 
 // ...existing code...
@@ -294,7 +303,7 @@ ssize_t CGI::writeToInput(const char* data, size_t len) {
         ssize_t n = ::write(_inputFd, data + total, len - total);
         if (n > 0) {
             total += n;
-            _lastOutputTime = time(NULL);
+            _lastOutputTime = Utils::now();
             if (total == len) break;          // all bytes written
             continue;                         // try to push more immediately
         }
@@ -329,7 +338,7 @@ ssize_t CGI::readFromOutput(char* buffer, size_t size) {
     Logger::debug("CGI::readFromOutput() about to read fd=" + Utils::intToString(_outputFd) + ", size=" + Utils::intToString((int)size));
     ssize_t bytesRead = read(_outputFd, buffer, size);
     if (bytesRead > 0) {
-        _lastOutputTime = time(NULL);
+        _lastOutputTime = Utils::now();
         _totalBytesRead += bytesRead;
         Logger::debug("CGI::readFromOutput() read " + Utils::intToString(bytesRead) + " bytes, totalRead=" + Utils::intToString(_totalBytesRead));
     } else if (bytesRead == 0) {
@@ -21,6 +21,10 @@
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 // Helper: find the end of HTTP-style headers in a buffer.
 // Supports CRLFCRLF ("\r\n\r\n") and LF LF ("\n\n").
@@ -39,32 +43,76 @@ static bool findHeaderBodySeparator(const std::string& buf, size_t& header_end_p
 }
 
 static const size_t CGI_WRITE_BUFFER_LIMIT = 256 * 1024U;
+// Segments handed to one sendmsg() call
+static const size_t SEND_IOV_MAX = 16;
+// Largest region handed to one sendfile() call (the Linux per-call cap)
+static const size_t SENDFILE_MAX = 0x7ffff000U;
+// Bytes of a streamed file compressed per step, and the queue level below
+// which the next step is taken
+static const size_t STREAM_BLOCK_SIZE = 65536;
+// Smaller bodies compress in less time than a round trip through the
+// worker pool takes
+static const size_t OFFLOAD_MIN_LENGTH = 65536;
+
+// Send part of a file region to a socket without copying it through user
+// space; returns bytes sent, 0 if the file ended early, or -1 with errno.
+static ssize_t sendFileRegion(int socketFd, int fileFd, off_t offset, size_t length) {
+    if (length > SENDFILE_MAX) length = SENDFILE_MAX;
+#ifdef __linux__
+    ssize_t sent;
+    do {
+        sent = sendfile(socketFd, fileFd, &offset, length);
+    } while (sent < 0 && errno == EINTR);
+    return sent;
+#else
+    char buffer[BUFFER_SIZE];
+    ssize_t n = pread(fileFd, buffer, std::min(length, sizeof(buffer)), offset);
+    if (n <= 0) return n;
+    return send(socketFd, buffer, n, MSG_NOSIGNAL);
+#endif
+}
 
 // ===== Client lifecycle =====
-// Global client counter to assign compact client numbers for diagnostics
+// Global client counter to assign compact client numbers for diagnostics.
+// Clients are created on several event-loop threads in threaded mode.
 static unsigned long g_clientCounter = 0;
+static pthread_mutex_t g_finalizersMutex = PTHREAD_MUTEX_INITIALIZER;
 
 // forward declaration for lifecycle logging helper (defined later)
 static void appendLifecycleLog(const std::string& line);
 
-Client::Client() : _fd(-1), _state(RECEIVING_REQUEST), _cgi(NULL), _cgiBytesSent(0),
-                   _keepAlive(false), _cgiFinishedWaitingForRequest(false),
+Client::Client() : _fd(-1), _listener(0), _state(RECEIVING_REQUEST), _cgi(NULL), _cgiBytesSent(0),
+                   _keepAlive(false), _keepAliveAllowed(true), _fileCache(NULL), _contentCache(NULL),
+                   _variantCache(NULL), _encoder(NULL), _workerPool(NULL), _completions(NULL), _job(NULL),
+                   _cgiFinishedWaitingForRequest(false),
                    _peerClosed(false), _cgiHeadersSent(false),
                    _sent100Continue(false), _cgiBodyRemaining((size_t)-1),
-                   _cgiBodyOffset(0), _clientNumber(++g_clientCounter), _cgiFinalized(false) { }
+                   _cgiBodyOffset(0), _clientNumber(__sync_add_and_fetch(&g_clientCounter, 1)), _cgiFinalized(false) {
+    updateLastActivity();
+    _initTimers();
+}
 
-Client::Client(int fd) : _fd(fd), _state(RECEIVING_REQUEST), _cgi(NULL), _cgiBytesSent(0),
-                   _keepAlive(false), _cgiFinishedWaitingForRequest(false),
+Client::Client(int fd) : _fd(fd), _listener(0), _state(RECEIVING_REQUEST), _cgi(NULL), _cgiBytesSent(0),
+                   _keepAlive(false), _keepAliveAllowed(true), _fileCache(NULL), _contentCache(NULL),
+                   _variantCache(NULL), _encoder(NULL), _workerPool(NULL), _completions(NULL), _job(NULL),
+                   _cgiFinishedWaitingForRequest(false),
                    _peerClosed(false), _cgiHeadersSent(false),
                    _sent100Continue(false), _cgiBodyRemaining((size_t)-1),
-                   _cgiBodyOffset(0), _clientNumber(++g_clientCounter), _cgiFinalized(false) { }
+                   _cgiBodyOffset(0), _clientNumber(__sync_add_and_fetch(&g_clientCounter, 1)), _cgiFinalized(false) {
+    updateLastActivity();
+    _initTimers();
+}
 
 Client::Client(const Client& other)
-    : _fd(other._fd), _state(other._state), _request(other._request), _response(other._response),
+    : _fd(other._fd), _listener(other._listener), _state(other._state), _request(other._request), _response(other._response),
         _receiveBuffer(other._receiveBuffer), _sendBuffer(other._sendBuffer), _cgiOutputBuffer(other._cgiOutputBuffer),
         _cgiInputCopy(other._cgiInputCopy), _cgiWriteBuffer(other._cgiWriteBuffer), _lastActivity(other._lastActivity),
-            _cgi(NULL), _cgiBytesSent(other._cgiBytesSent), _keepAlive(other._keepAlive), _cgiFinishedWaitingForRequest(other._cgiFinishedWaitingForRequest),
+            _cgi(NULL), _cgiBytesSent(other._cgiBytesSent), _keepAlive(other._keepAlive), _keepAliveAllowed(other._keepAliveAllowed), _fileCache(other._fileCache),
+            _contentCache(other._contentCache), _variantCache(other._variantCache), _servedPath(other._servedPath), _compression(other._compression), _encoder(NULL),
+            _workerPool(other._workerPool), _completions(other._completions), _job(NULL),
+            _cgiFinishedWaitingForRequest(other._cgiFinishedWaitingForRequest),
         _peerClosed(other._peerClosed), _cgiHeadersSent(other._cgiHeadersSent), _sent100Continue(other._sent100Continue), _cgiBodyRemaining(other._cgiBodyRemaining), _clientNumber(other._clientNumber), _cgiFinalized(other._cgiFinalized) {
+    _initTimers();
     // log COPY event
     {
         std::ostringstream ss;
@@ -76,6 +124,7 @@ Client::Client(const Client& other)
 Client& Client::operator=(const Client& other) {
     if (this != &other) {
         _fd = other._fd;
+        _listener = other._listener;
         _state = other._state;
         _request = other._request;
         _response = other._response;
@@ -89,6 +138,16 @@ Client& Client::operator=(const Client& other) {
         _cgi = NULL; // do not copy running CGI process
         _cgiBytesSent = other._cgiBytesSent;
         _keepAlive = other._keepAlive;
+        _keepAliveAllowed = other._keepAliveAllowed;
+        _fileCache = other._fileCache;
+        _contentCache = other._contentCache;
+        _variantCache = other._variantCache;
+        _servedPath = other._servedPath;
+        _compression = other._compression;
+        _discardEncoder(); // a stream in progress is not copied
+        _cancelJob();      // nor a body out on the worker pool
+        _workerPool = other._workerPool;
+        _completions = other._completions;
         _cgiFinishedWaitingForRequest = other._cgiFinishedWaitingForRequest;
         _peerClosed = other._peerClosed;
         _cgiHeadersSent = other._cgiHeadersSent;
@@ -119,6 +178,8 @@ Client::~Client() {
         appendLifecycleLog(ss.str());
     }
     if (_cgi) { delete _cgi; _cgi = NULL; }
+    _discardEncoder();
+    _cancelJob();
     _cgiWriteBuffer.clear();
     _cgiInputCopy.clear();
     _cgiBytesSent = 0;
@@ -139,6 +200,21 @@ bool Client::hasPeerClosed() const { return _peerClosed; }
 void Client::setState(State state) { _state = state; }
 void Client::setResponse(const Response& response) { _response = response; }
 void Client::setKeepAlive(bool keepAlive) { _keepAlive = keepAlive; }
+void Client::setKeepAliveAllowed(bool allowed) { _keepAliveAllowed = allowed; }
+void Client::setFileCache(FileCache* cache) { _fileCache = cache; }
+void Client::setContentCache(ContentCache* cache) { _contentCache = cache; }
+void Client::setVariantCache(VariantCache* cache) { _variantCache = cache; }
+
+void Client::setWorkerPool(WorkerPool* pool, WorkerPool::CompletionQueue* completions) {
+    _workerPool = pool;
+    _completions = completions;
+}
+
+// Keep-alive as requested by the client, unless the server is shedding load
+bool Client::_negotiateKeepAlive(bool isHttp11, const std::string& connection) const {
+    if (!_keepAliveAllowed) return false;
+    return isHttp11 ? (connection != "close") : (connection == "keep-alive");
+}
 void Client::setCgi(CGI* cgi) {
     if (_cgi) delete _cgi;
     _cgi = cgi;
@@ -154,6 +230,15 @@ void Client::setCgi(CGI* cgi) {
 
 void Client::markPeerClosed() { _peerClosed = true; }
 
+TimerWheel::Timer& Client::getTimer(TimerKind kind) { return _timers[kind]; }
+
+void Client::_initTimers() {
+    for (int i = 0; i < TIMER_COUNT; ++i) {
+        _timers[i].owner = this;
+        _timers[i].kind = i;
+    }
+}
+
 ssize_t Client::receiveData() {
     char buffer[BUFFER_SIZE];
     ssize_t bytesRead = recv(_fd, buffer, sizeof(buffer), 0);
@@ -172,13 +257,59 @@ ssize_t Client::receiveData() {
 }
 
 ssize_t Client::sendData() {
-    if (_sendBuffer.empty()) return 0;
-
-    ssize_t bytesSent = send(_fd, _sendBuffer.data(), _sendBuffer.size(), MSG_NOSIGNAL);
+    if (_sendBuffer.empty() && !_encoder) return 0;
+
+    // Gather-write the queued segments until the queue is drained or the
+    // socket is full. sendmsg() rather than writev() for MSG_NOSIGNAL; file
+    // regions go out with sendfile() once the bytes before them are sent.
+    // A streamed compressed file is topped up as the queue drains.
+    ssize_t bytesSent = 0;
+    for (;;) {
+        if (_encoder && _encoder->fd >= 0 && _sendBuffer.size() < STREAM_BLOCK_SIZE) {
+            _pumpEncodedFile();
+            if (_state == ERROR_STATE) return -1;
+        }
+        if (_sendBuffer.empty()) break;
+        int fileFd;
+        off_t fileOffset;
+        size_t batchSize = 0;
+        ssize_t sent;
+        if (_sendBuffer.frontFile(fileFd, fileOffset, batchSize)) {
+            sent = sendFileRegion(_fd, fileFd, fileOffset, batchSize);
+            if (sent == 0) {
+                // The file shrank under us: the promised length can't be met
+                Logger::error("File body ended early, closing connection");
+                _state = ERROR_STATE;
+                return -1;
+            }
+        } else {
+            struct iovec iov[SEND_IOV_MAX];
+            struct msghdr msg;
+            bool fileFollows = false;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = _sendBuffer.fillIovec(iov, SEND_IOV_MAX, &fileFollows);
+            for (size_t i = 0; i < (size_t)msg.msg_iovlen; ++i) batchSize += iov[i].iov_len;
+
+            int flags = MSG_NOSIGNAL;
+#ifdef MSG_MORE
+            // Let the headers share a segment with the start of the file
+            if (fileFollows) flags |= MSG_MORE;
+#endif
+            sent = sendmsg(_fd, &msg, flags);
+        }
+        if (sent <= 0) {
+            // Errors after some progress are picked up on the next call
+            if (bytesSent == 0) bytesSent = sent;
+            break;
+        }
+        _sendBuffer.consume(sent);
+        bytesSent += sent;
+        if ((size_t)sent < batchSize) break;
+    }
     if (bytesSent > 0) {
-        _sendBuffer.erase(0, bytesSent);
         updateLastActivity();
-        if (_sendBuffer.empty()) {
+        if (_sendBuffer.empty() && !_encoder) {
             if (_state == SENDING_RESPONSE) {
                 // IMPORTANT: If the client is still uploading the current request
                 // body (request not yet fully parsed/complete), do NOT reset the
@@ -214,6 +345,9 @@ ssize_t Client::sendData() {
 }
 
 void Client::processRequest(const class Config& config) {
+    // Nothing more is read while the response is out on the worker pool
+    if (_state == WAITING_FOR_WORKER) return;
+
     // Parse any received data
 
     if (!_receiveBuffer.empty()) {
@@ -228,7 +362,7 @@ void Client::processRequest(const class Config& config) {
             std::string expect = Utils::toLowerCase(_request.getHeader("expect"));
             if (expect.find("100-continue") != std::string::npos) {
                 const std::string cont = "HTTP/1.1 100 Continue\r\n\r\n";
-                _sendBuffer.insert(0, cont);
+                _sendBuffer.prepend(cont);
                 _sent100Continue = true;
                 Logger::debug("Sent interim 100 Continue");
             }
@@ -238,10 +372,10 @@ void Client::processRequest(const class Config& config) {
             _response = Response::createErrorResponse(HTTP_BAD_REQUEST);
             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-            _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
             _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
             if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-            _sendBuffer = _response.toString();
+            _queueResponse();
             _state = SENDING_RESPONSE;
             return;
         }
@@ -257,7 +391,7 @@ void Client::processRequest(const class Config& config) {
     }
 
     // Identify server and location for routing and policy decisions
-    Config::ServerBlock serverBlock = config.getDefaultServer();
+    const Config::ServerBlock& serverBlock = config.findServer(_listener, _request.getHeader("host"));
     const Location* location = NULL;
     if (!_request.getUri().empty()) {
         location = config.findLocation(serverBlock, _request.getUri());
@@ -270,10 +404,10 @@ void Client::processRequest(const class Config& config) {
         _response = Response::createErrorResponse(HTTP_REQUEST_TIMEOUT);
         bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
         std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-        _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+        _keepAlive = _negotiateKeepAlive(isHttp11, conn);
         _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
     if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-        _sendBuffer = _response.toString();
+        _queueResponse();
         _state = SENDING_RESPONSE;
         return;
     }
@@ -286,10 +420,10 @@ void Client::processRequest(const class Config& config) {
             _response = Response::createErrorResponse(HTTP_PAYLOAD_TOO_LARGE);
             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-            _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
             _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
             if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-            _sendBuffer = _response.toString();
+            _queueResponse();
             _state = SENDING_RESPONSE;
             return;
         }
@@ -307,10 +441,10 @@ void Client::processRequest(const class Config& config) {
             if (!allowList.empty()) _response.setHeader("Allow", allowList);
             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-            _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
             _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
             if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-            _sendBuffer = _response.toString();
+            _queueResponse();
             _state = SENDING_RESPONSE;
             return;
         }
@@ -326,10 +460,10 @@ void Client::processRequest(const class Config& config) {
                 _response = Response::createErrorResponse(HTTP_PAYLOAD_TOO_LARGE);
                 bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
                 std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-                _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+                _keepAlive = _negotiateKeepAlive(isHttp11, conn);
                 _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
                 if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-                _sendBuffer = _response.toString();
+                _queueResponse();
                 _state = SENDING_RESPONSE;
                 return;
             }
@@ -341,7 +475,7 @@ void Client::processRequest(const class Config& config) {
             if (!_cgi->execute(_request, resolvedScriptPath)) {
                 delete _cgi; _cgi = NULL;
                 _response = Response::createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
-                _sendBuffer = _response.toString();
+                _queueResponse();
                 _state = SENDING_RESPONSE;
                 return;
             }
@@ -359,7 +493,7 @@ void Client::processRequest(const class Config& config) {
                 if (!Utils::dechunk(_request.getBody(), dechunked)) {
                     delete _cgi; _cgi = NULL;
                     _response = Response::createErrorResponse(HTTP_BAD_REQUEST);
-                    _sendBuffer = _response.toString();
+                    _queueResponse();
                     _state = SENDING_RESPONSE;
                     return;
                 }
@@ -393,10 +527,10 @@ void Client::processRequest(const class Config& config) {
                 if (!allowList.empty()) _response.setHeader("Allow", allowList);
                 bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
                 std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-                _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+                _keepAlive = _negotiateKeepAlive(isHttp11, conn);
                 _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
                 if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-                _sendBuffer = _response.toString();
+                _queueResponse();
                 _state = SENDING_RESPONSE;
                 return;
             }
@@ -421,10 +555,10 @@ void Client::processRequest(const class Config& config) {
                 if (!allowList.empty()) _response.setHeader("Allow", allowList);
                 bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
                 std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-                _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+                _keepAlive = _negotiateKeepAlive(isHttp11, conn);
                 _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
                 if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
-                _sendBuffer = _response.toString();
+                _queueResponse();
                 _state = SENDING_RESPONSE;
                 return;
             }
@@ -433,12 +567,13 @@ void Client::processRequest(const class Config& config) {
         // Redirects
         if (location && !location->getRedirect().empty()) {
             _response = Response::createRedirectResponse(HTTP_FOUND, location->getRedirect());
-            _sendBuffer = _response.toString();
+            _queueResponse();
             _state = SENDING_RESPONSE;
             return;
         }
 
         // Dispatch
+        _compression = location ? location->getCompression() : Compression::Settings();
         Logger::debug("Processing " + _request.getMethod() + " request for path: " + _request.getPath());
         if (_request.getMethod() == "GET") {
             _response = _handleGetRequest(serverBlock, location);
@@ -459,16 +594,22 @@ void Client::processRequest(const class Config& config) {
         {
             std::string connection = Utils::toLowerCase(_request.getHeader("connection"));
             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
-            _keepAlive = isHttp11 ? (connection != "close") : (connection == "keep-alive");
+            _keepAlive = _negotiateKeepAlive(isHttp11, connection);
             _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
             if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
         }
 
+        // A body out on the worker pool is queued once it is back (finishJob)
+        if (_job) {
+            _state = WAITING_FOR_WORKER;
+            return;
+        }
+
         // Serialize (omit body for HEAD)
         if (_request.getMethod() == "HEAD") {
-            _sendBuffer = _response.toString(false);
+            _queueResponse(false);
         } else {
-            _sendBuffer = _response.toString();
+            _queueResponse();
         }
         _state = SENDING_RESPONSE;
     }
@@ -504,15 +645,23 @@ Response Client::_handleGetRequest(const Config::ServerBlock& serverConfig, cons
     // unless explicitly disallowed. CGI execution for .bla is handled for POST
     // earlier in processRequest; for GET we fall through to static file logic.
 
-    if (Utils::isDirectory(fullPath)) {
+    // Lookups go through the loop's cache: a hot path costs no syscall,
+    // and at most one stat() (plus an open() for GET) once it is stale
+    FileCache uncached(0, 0);
+    FileCache& files = _fileCache ? *_fileCache : uncached;
+
+    // Opening waits until we know the body is wanted (see _serveStaticFile)
+    const FileCache::Entry* file = &files.lookup(fullPath, false);
+    if (file->error == 0 && S_ISDIR(file->st.st_mode)) {
         // Try index
         std::string index = location ? location->getIndex() : std::string("index.html");
         if (!index.empty()) {
             std::string indexPath = fullPath;
             if (indexPath.size() && indexPath[indexPath.size()-1] != '/') indexPath += "/";
             indexPath += index;
-            if (Utils::fileExists(indexPath)) {
-                return Response::createFileResponse(indexPath, Utils::getMimeType(Utils::getFileExtension(indexPath)));
+            const FileCache::Entry& indexFile = files.lookup(indexPath, false);
+            if (indexFile.error == 0 && !S_ISDIR(indexFile.st.st_mode)) {
+                return _serveStaticFile(files, indexFile, location);
             }
         }
         // Autoindex
@@ -524,11 +673,182 @@ Response Client::_handleGetRequest(const Config::ServerBlock& serverConfig, cons
         return Response::createErrorResponse(HTTP_NOT_FOUND);
     }
 
-    if (!Utils::fileExists(fullPath)) {
+    return _serveStaticFile(files, *file, location);
+}
+
+// If-None-Match takes precedence over If-Modified-Since (RFC 9110 13.2.2).
+// GET and HEAD compare entity tags weakly.
+bool Client::_isNotModified(const std::string& etag, time_t mtime) const {
+    std::string ifNoneMatch = Utils::trim(_request.getHeader("if-none-match"));
+    if (!ifNoneMatch.empty()) {
+        if (ifNoneMatch == "*") return true;
+        std::string opaque = (etag.compare(0, 2, "W/") == 0) ? etag.substr(2) : etag;
+        std::vector<std::string> tags = Utils::split(ifNoneMatch, ",");
+        for (size_t i = 0; i < tags.size(); ++i) {
+            std::string tag = Utils::trim(tags[i]);
+            if (tag.compare(0, 2, "W/") == 0) tag = tag.substr(2);
+            if (tag == opaque) return true;
+        }
+        return false;
+    }
+
+    std::string ifModifiedSince = Utils::trim(_request.getHeader("if-modified-since"));
+    time_t since;
+    return !ifModifiedSince.empty() && Utils::parseHttpDate(ifModifiedSince, since) && mtime <= since;
+}
+
+// Vary: Accept-Encoding, kept alongside whatever the response already varies on
+static void varyOnAcceptEncoding(Response& response) {
+    std::string vary = response.getHeaderCI("vary");
+    if (vary.empty()) {
+        response.setHeader("Vary", "Accept-Encoding");
+    } else if (vary != "*" && Utils::toLowerCase(vary).find("accept-encoding") == std::string::npos) {
+        response.removeHeader("Vary");
+        response.setHeader("Vary", vary + ", Accept-Encoding");
+    }
+}
+
+Response Client::_serveStaticFile(FileCache& files, const FileCache::Entry& stated, const Location* location) {
+    const FileCache::Entry* entry = &stated;
+    if (entry->error == ENOENT || entry->error == ENOTDIR) {
         return Response::createErrorResponse(HTTP_NOT_FOUND);
     }
-    std::string mime = Utils::getMimeType(Utils::getFileExtension(fullPath));
-    return Response::createFileResponse(fullPath, mime);
+    if (entry->error == EACCES || (entry->error == 0 && !S_ISREG(entry->st.st_mode))) {
+        return Response::createErrorResponse(HTTP_FORBIDDEN);
+    }
+    if (entry->error) {
+        Logger::error("Failed to open file: " + entry->path + ": " + strerror(entry->error));
+        return Response::createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
+    }
+
+    // gzip_static: a prebuilt file.gz at least as new as the file is sent
+    // instead, as it is. Copies first: a cache lookup may reuse `*entry`.
+    std::string mimeType = entry->mimeType;
+    bool gzipStatic = location && location->getGzipStatic();
+    bool precompressed = false;
+    if (gzipStatic && Compression::getQuality(_request.getHeader("accept-encoding"), "gzip") > 0) {
+        std::string path = entry->path;
+        time_t mtime = entry->st.st_mtime;
+        const FileCache::Entry& sidecar = files.lookup(path + ".gz", false);
+        precompressed = sidecar.error == 0 && S_ISREG(sidecar.st.st_mode) && sidecar.st.st_mtime >= mtime;
+        entry = precompressed ? &sidecar : &files.lookup(path, false);
+    }
+
+    // HEAD and revalidations need nothing stat() has not already told us:
+    // don't open, let alone read, the file
+    _servedPath = entry->path;
+    Response response = Response::createFileMetadataResponse(entry->st, mimeType);
+    if (precompressed) response.setHeader("Content-Encoding", Compression::getEncodingHeader(Compression::GZIP));
+    // Whether or not this client gets an encoded body, another may: caches
+    // have to keep the variants apart, on a 304 as well
+    if (gzipStatic || Compression::shouldCompress(mimeType, (size_t)entry->st.st_size, _compression)) {
+        varyOnAcceptEncoding(response);
+    }
+    // expires/add_header of the location, pre-rendered at config load; a 304
+    // carries them too so caches refresh the freshness of their copy
+    if (location) {
+        const Location::HeaderList& extra = location->getResponseHeaders();
+        for (Location::HeaderList::const_iterator it = extra.begin(); it != extra.end(); ++it) {
+            response.setHeader(it->first, it->second);
+        }
+    }
+    if (_isNotModified(response.getHeader("ETag"), entry->st.st_mtime)) {
+        response.setStatusCode(HTTP_NOT_MODIFIED);
+        response.removeHeader("Content-Length");
+        response.removeHeader("Content-Type");
+        return response;
+    }
+    if (_request.getMethod() == "HEAD") {
+        if (!precompressed) _describeCompression(response, mimeType, (size_t)entry->st.st_size);
+        return response;
+    }
+
+    // So are byte ranges: only the requested regions are ever read or sent
+    Range range;
+    std::string rangeHeader = _request.getHeader("range");
+    if (!rangeHeader.empty() && _isRangeCurrent(response) &&
+        !range.parseRangeHeader(rangeHeader, (size_t)entry->st.st_size) && Range::isRangeRequest(rangeHeader)) {
+        Response unsatisfiable = Response::createErrorResponse(HTTP_RANGE_NOT_SATISFIABLE);
+        unsatisfiable.setHeader("Content-Range", range.generateUnsatisfiedRangeHeader());
+        return unsatisfiable;
+    }
+
+    entry = &files.lookup(entry->path, true);
+    if (entry->error || entry->fd < 0) {
+        Logger::error("Failed to open file: " + entry->path + ": " + strerror(entry->error));
+        return Response::createErrorResponse(entry->error == EACCES ? HTTP_FORBIDDEN : HTTP_INTERNAL_SERVER_ERROR);
+    }
+    const FileCache::Entry& file = *entry;
+
+    // Small hot files go out from memory shared by every connection
+    SharedBuffer content;
+    if (_contentCache && _contentCache->lookup(file, content)) {
+        response.setSharedBody(content);
+        _applyByteRanges(response, range, mimeType);
+        return response;
+    }
+    // Anything larger goes out with sendfile(), or, when it is compressed,
+    // through the encoder a block at a time (_pumpEncodedFile)
+    // The response owns (and closes) its own fd; the cache keeps the original
+    int fd = fcntl(file.fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        Logger::error("Failed to duplicate file descriptor: " + std::string(strerror(errno)));
+        return Response::createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
+    }
+    response.setFileBody(fd, 0, (size_t)file.st.st_size);
+    _applyByteRanges(response, range, mimeType);
+    return response;
+}
+
+// If-Range (RFC 9110 13.1.5): ranges only apply while the validator still
+// matches, otherwise the whole representation is sent. A Last-Modified at
+// least a second old can no longer be shared by a later write, which makes
+// it, and the tag built from it, good enough as a strong validator.
+bool Client::_isRangeCurrent(const Response& response) const {
+    std::string ifRange = Utils::trim(_request.getHeader("if-range"));
+    if (ifRange.empty()) return true;
+
+    time_t mtime;
+    if (!Utils::parseHttpDate(response.getHeader("Last-Modified"), mtime) || mtime >= time(NULL)) return false;
+    if (ifRange[0] == '"' || ifRange.compare(0, 2, "W/") == 0) {
+        std::string etag = response.getHeader("ETag");
+        if (etag.compare(0, 2, "W/") == 0) etag = etag.substr(2);
+        if (ifRange.compare(0, 2, "W/") == 0) ifRange = ifRange.substr(2);
+        return !etag.empty() && ifRange == etag;
+    }
+    time_t since;
+    return Utils::parseHttpDate(ifRange, since) && since == mtime;
+}
+
+// Narrow a file-backed or shared body to the satisfiable ranges: one range
+// is a plain 206, several become multipart/byteranges whose parts are
+// regions of the same body
+void Client::_applyByteRanges(Response& response, const Range& range, const std::string& contentType) {
+    if (!range.isValid()) return;
+
+    size_t base = response.hasFileBody() ? (size_t)response.getFileOffset() : response.getSharedOffset();
+    response.setStatusCode(HTTP_PARTIAL_CONTENT);
+    if (range.isSingleRange()) {
+        ByteRange only = range.getFirstRange();
+        size_t length = only.end - only.start + 1;
+        if (response.hasFileBody()) {
+            response.setFileRange((off_t)(base + only.start), length);
+        } else {
+            response.setSharedRange(base + only.start, length);
+        }
+        response.setHeader("Content-Range", range.generateContentRangeHeader(only));
+        return;
+    }
+
+    const std::vector<ByteRange>& ranges = range.getRanges();
+    std::vector<Response::BodyPart> parts(ranges.size());
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        parts[i].header = range.generatePartHeader(ranges[i], contentType);
+        parts[i].offset = base + ranges[i].start;
+        parts[i].length = ranges[i].end - ranges[i].start + 1;
+    }
+    response.setBodyParts(parts, range.generateMultipartTrailer());
+    response.setHeader("Content-Type", range.getMultipartContentType());
 }
 
 Response Client::_handlePostRequest(const Config::ServerBlock& serverConfig, const Location* location) {
@@ -570,6 +890,7 @@ Response Client::_handlePostRequest(const Config::ServerBlock& serverConfig, con
         std::string fullPath = uploadPath + "/" + filename;
         
         if (Utils::writeFile(fullPath, _request.getBody())) {
+            _invalidateCached(fullPath);
             Response response(HTTP_CREATED);
             response.setHeader("Content-Type", "text/plain");
             response.setBody("File uploaded successfully");
@@ -616,6 +937,7 @@ Response Client::_handlePutRequest(const Config::ServerBlock& serverConfig, cons
     // For testing purposes, handle PUT requests to create/update files
     if (path.find("put_test") != std::string::npos) {
         if (Utils::writeFile(fullPath, _request.getBody())) {
+            _invalidateCached(fullPath);
             Response response(HTTP_CREATED);
             response.setHeader("Content-Type", "text/plain");
             response.setBody("File created/updated successfully");
@@ -641,6 +963,7 @@ Response Client::_handleDeleteRequest(const Config::ServerBlock& serverConfig, c
     
     if (Utils::fileExists(fullPath)) {
         if (unlink(fullPath.c_str()) == 0) {
+            _invalidateCached(fullPath);
             Response response(HTTP_NO_CONTENT);
             response.setComplete(true);
             return response;
@@ -652,6 +975,13 @@ Response Client::_handleDeleteRequest(const Config::ServerBlock& serverConfig, c
     }
 }
 
+// The caches would otherwise keep serving what was there before, until the
+// lookup goes stale (or, for the content, as long as size and mtime match)
+void Client::_invalidateCached(const std::string& path) {
+    if (_fileCache) _fileCache->invalidate(path);
+    if (_contentCache) _contentCache->invalidate(path);
+}
+
 void Client::handleCgiInput() {
     if (!_cgi || _cgi->getInputFd() == -1)
         return;
@@ -724,7 +1054,7 @@ void Client::handleCgiOutput() {
             // Honor keep-alive semantics from the originating request
             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-            _keepAlive = isHttp11 ? (conn != "close") : (conn == "keep-alive");
+            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
             _response.setHeader("Connection", _keepAlive ? "keep-alive" : "close");
             if (_keepAlive) _response.setHeader("Keep-Alive", "timeout=600, max=100");
 
@@ -736,16 +1066,34 @@ void Client::handleCgiOutput() {
             // Strip a pending 100-Continue before sending final headers
             {
                 const std::string k100 = "HTTP/1.1 100 Continue\r\n\r\n";
-                if (_sendBuffer.compare(0, k100.size(), k100) == 0) {
-                    _sendBuffer.erase(0, k100.size());
+                if (_sendBuffer.startsWith(k100)) {
+                    _sendBuffer.consume(k100.size());
+                }
+            }
+
+            if (_startCgiEncoding()) {
+                // Compressed as it arrives; a declared length still caps
+                // how much of the CGI output is taken
+                if (!cl.empty() && Utils::stringToInt(cl) >= 0) _cgiBodyRemaining = (size_t)Utils::stringToInt(cl);
+                _response.removeHeader("Content-Length");
+                _sendBuffer.append(_response.toString(false));
+                _cgiHeadersSent = true;
+                _cgiOutputBuffer.clear();
+                _state = CGI_STREAMING_BODY;
+                size_t toCopy = std::min(_cgiBodyRemaining, firstBody.size());
+                if (toCopy > 0) {
+                    _encodeCgiOutput(firstBody.data(), toCopy);
+                    if (_cgiBodyRemaining != (size_t)-1) _cgiBodyRemaining -= toCopy;
                 }
+                if (_cgiBodyRemaining == 0) finalizeCgiResponse();
+                return;
             }
 
             if (!cl.empty()) {
                 int clInt = Utils::stringToInt(cl);
                 if (clInt >= 0) {
                     _cgiBodyRemaining = (size_t)clInt;
-                    _sendBuffer += _response.toString(false); // headers only
+                    _sendBuffer.append(_response.toString(false)); // headers only
                     _cgiHeadersSent = true;
                     if (!firstBody.empty()) {
                         size_t toCopy = std::min(_cgiBodyRemaining, firstBody.size());
@@ -773,7 +1121,8 @@ void Client::handleCgiOutput() {
                 if (_cgiBodyRemaining != (size_t)-1) {
                     size_t toCopy = std::min(_cgiBodyRemaining, (size_t)bytesRead);
                     if (toCopy > 0) {
-                        _sendBuffer.append(buffer, toCopy);
+                        if (_encoder) _encodeCgiOutput(buffer, toCopy);
+                        else _sendBuffer.append(buffer, toCopy);
                         _cgiBodyRemaining -= toCopy;
                     }
                     // Ignore any extra bytes beyond the declared Content-Length
@@ -785,7 +1134,8 @@ void Client::handleCgiOutput() {
                     }
                 } else {
                     // Unknown length: keep streaming until EOF
-                    _sendBuffer.append(buffer, bytesRead);
+                    if (_encoder) _encodeCgiOutput(buffer, bytesRead);
+                    else _sendBuffer.append(buffer, bytesRead);
                 }
             } else {
                 // Deferred mode: keep buffering until EOF to compute Content-Length
@@ -806,6 +1156,7 @@ void Client::handleCgiOutput() {
         if (_state == CGI_STREAMING_BODY) {
             if (_cgiHeadersSent) {
                 // We were streaming; mark complete and let send loop drain
+                _finishEncodedBody();
                 _response.setComplete(true);
                 _state = SENDING_RESPONSE;
                 // CGI is finished; cleanup happens in finalizeCgiResponse or later
@@ -854,6 +1205,7 @@ void Client::finalizeCgiResponse() {
     void* cgi_ptr = (void*)_cgi;
     time_t cgi_start = _cgi->getStartTime();
     std::ofstream dbg("finalize_cgi_debug.log", std::ios::app);
+    pthread_mutex_lock(&g_finalizersMutex);
     std::map<void*, std::pair<void*, std::pair<unsigned long, time_t> > >::iterator it = s_finalizers.find(cgi_ptr);
     if (it != s_finalizers.end()) {
         void* first_this = it->second.first;
@@ -873,6 +1225,7 @@ void Client::finalizeCgiResponse() {
     }
     // Record (or overwrite) the finalizer for this CGI pointer with its start time
     s_finalizers[cgi_ptr] = std::make_pair((void*)this, std::make_pair(_clientNumber, cgi_start));
+    pthread_mutex_unlock(&g_finalizersMutex);
 
     // Diagnostic entry for the actual finalize event
     dbg << "Entered finalizeCgiResponse client=" << _clientNumber << " this=" << (void*)this << " fd=" << _fd
@@ -887,6 +1240,7 @@ void Client::finalizeCgiResponse() {
     // complete (if not already) and clean up the CGI process.
     if (_cgiHeadersSent) {
         Logger::debug("finalizeCgiResponse: headers already sent; preserving existing send buffer and cleaning up CGI only");
+        _finishEncodedBody();
         _response.setComplete(true);
         delete _cgi;
         _cgi = NULL;
@@ -932,8 +1286,8 @@ void Client::finalizeCgiResponse() {
     // and clients (which could otherwise see 100 followed by raw body bytes).
     {
         const std::string k100 = "HTTP/1.1 100 Continue\r\n\r\n";
-        while (_sendBuffer.compare(0, k100.size(), k100) == 0) {
-            _sendBuffer.erase(0, k100.size());
+        while (_sendBuffer.startsWith(k100)) {
+            _sendBuffer.consume(k100.size());
         }
     }
 
@@ -998,7 +1352,7 @@ void Client::finalizeCgiResponse() {
             if (_cgi) {
                 time_t start = _cgi->getStartTime();
                 if (start != 0) {
-                    int elapsed = (int)(time(NULL) - start);
+                    int elapsed = (int)(Utils::now() - start);
                     summary += "Execution time: " + Utils::intToString(elapsed) + "s\n";
                 }
             }
@@ -1011,7 +1365,7 @@ void Client::finalizeCgiResponse() {
             sumResp.setBody(summary);
             sumResp.setComplete(true);
             _response = sumResp;
-            _sendBuffer = _response.toString();
+            _queueResponse();
         } else {
             // 2) Raw-return mode: return raw CGI stdout as body
             const char* rawReturnEnv = getenv("WEBSERV_DEBUG_RETURN_RAW_CGI_AS_BODY");
@@ -1022,7 +1376,7 @@ void Client::finalizeCgiResponse() {
                 rawResp.setBody(_cgiOutputBuffer);
                 rawResp.setComplete(true);
                 _response = rawResp;
-                _sendBuffer = _response.toString();
+                _queueResponse();
             } else {
                 // 3) Normal behavior:
                 // If we have already started streaming AND the send buffer begins
@@ -1035,8 +1389,8 @@ void Client::finalizeCgiResponse() {
                 // Validate that the send buffer actually begins with a final HTTP response
                 // (and not just raw body or an interim response that was stripped above).
                 bool hasQueuedHttp = (_sendBuffer.size() >= 9 &&
-                                      _sendBuffer.compare(0, 5, "HTTP/") == 0 &&
-                                      _sendBuffer.find("\r\n\r\n") != std::string::npos);
+                                      _sendBuffer.startsWith("HTTP/") &&
+                                      _sendBuffer.contains("\r\n\r\n"));
                 if (_cgiHeadersSent && hasQueuedHttp) {
                     Logger::debug("Preserving existing send buffer and marking response complete.");
                     _response.setComplete(true);
@@ -1052,11 +1406,7 @@ void Client::finalizeCgiResponse() {
                         {
                             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
                             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-                            if (isHttp11) {
-                                _keepAlive = (conn != "close");
-                            } else {
-                                _keepAlive = (conn == "keep-alive");
-                            }
+                            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
                             if (_keepAlive) {
                                 raw.setHeader("Connection", "keep-alive");
                                 raw.setHeader("Keep-Alive", "timeout=600, max=100");
@@ -1066,7 +1416,7 @@ void Client::finalizeCgiResponse() {
                         }
                         raw.setComplete(true);
                         _response = raw;
-                        _sendBuffer = _response.toString();
+                        _queueResponse();
                     } else {
                         // Parse headers and compute Content-Length over full body
                         std::string headersStr = _cgiOutputBuffer.substr(0, header_end_pos);
@@ -1097,11 +1447,7 @@ void Client::finalizeCgiResponse() {
                         {
                             bool isHttp11 = (_request.getVersion() == "HTTP/1.1");
                             std::string conn = Utils::toLowerCase(_request.getHeader("connection"));
-                            if (isHttp11) {
-                                _keepAlive = (conn != "close");
-                            } else {
-                                _keepAlive = (conn == "keep-alive");
-                            }
+                            _keepAlive = _negotiateKeepAlive(isHttp11, conn);
                             if (_keepAlive) {
                                 r.setHeader("Connection", "keep-alive");
                                 r.setHeader("Keep-Alive", "timeout=600, max=100");
@@ -1112,7 +1458,9 @@ void Client::finalizeCgiResponse() {
                         r.setComplete(true);
                         _response = r;
                         // Build full HTTP message (status+headers+CRLF+body)
-                        _sendBuffer = _response.toString(false) + body;
+                        _sendBuffer.clear();
+                        _sendBuffer.append(_response.toString(false));
+                        _sendBuffer.appendOwned(body);
                     }
                 }
             }
@@ -1134,12 +1482,13 @@ void Client::finalizeCgiResponse() {
     _cgiFinalized = true;
 
     if (!preserved && _sendBuffer.empty()) {
-        _sendBuffer = _response.toString();
+        _queueResponse();
     }
 
     FILE* ff = fopen("/tmp/final_send_buffer.bin", "wb");
     if (ff) {
-        fwrite(_sendBuffer.data(), 1, _sendBuffer.size(), ff);
+        std::string queued = _sendBuffer.str();
+        fwrite(queued.data(), 1, queued.size(), ff);
         fclose(ff);
     }
     FILE* fi = fopen("/tmp/cgi_raw_stdin_before_write.bin", "wb");
@@ -1151,7 +1500,7 @@ void Client::finalizeCgiResponse() {
     {
         static int raw_seq2 = 0;
         char outpath2[256];
-        snprintf(outpath2, sizeof(outpath2), "/tmp/cgi_stdout_stderr_%d_%d.txt", _fd, ++raw_seq2);
+        snprintf(outpath2, sizeof(outpath2), "/tmp/cgi_stdout_stderr_%d_%d.txt", _fd, __sync_add_and_fetch(&raw_seq2, 1));
         Logger::debug(std::string("Attempting to write final CGI stdout/stderr dump to: ") + outpath2);
         FILE* fout2 = fopen(outpath2, "w");
         if (fout2) {
@@ -1192,11 +1541,11 @@ bool Client::isWaitingForCgiWrite() const {
 }
 
 void Client::updateLastActivity() {
-    _lastActivity = time(NULL);
+    _lastActivity = Utils::now();
 }
 
 bool Client::hasTimedOut(int timeoutSeconds) const {
-    return (time(NULL) - _lastActivity) > timeoutSeconds;
+    return (Utils::now() - _lastActivity) > timeoutSeconds;
 }
 
 void Client::reset() {
@@ -1210,6 +1559,10 @@ void Client::reset() {
 
     _request.reset();
     _response.reset();
+    _servedPath.clear();
+    _compression = Compression::Settings();
+    _discardEncoder();
+    _cancelJob();
     _receiveBuffer.clear();
     _sendBuffer.clear();
     if (_cgi) {
@@ -1235,6 +1588,7 @@ void Client::reset() {
 }
 
 void Client::close() {
+    _cancelJob();
     if (_fd != -1) {
         ::close(_fd);
         _fd = -1;
@@ -1242,11 +1596,104 @@ void Client::close() {
     _state = FINISHED;
 }
 
+void Client::attach(int fd, int listener) {
+    _fd = fd;
+    _listener = listener;
+    _state = RECEIVING_REQUEST;
+    _keepAlive = false;
+    _keepAliveAllowed = true;
+    _peerClosed = false;
+    _clientNumber = __sync_add_and_fetch(&g_clientCounter, 1);
+    updateLastActivity();
+}
+
+// Drop a buffer's storage only when it grew past what the pool keeps
+static void trimCapacity(std::string& buffer, size_t maxCapacity) {
+    if (buffer.capacity() > maxCapacity) {
+        std::string().swap(buffer);
+    }
+}
+
+void Client::recycle(size_t maxBufferCapacity) {
+    reset();
+    _fd = -1;
+    _state = FINISHED;
+    _keepAlive = false;
+    trimCapacity(_receiveBuffer, maxBufferCapacity);
+    _sendBuffer.trim(maxBufferCapacity);
+    trimCapacity(_cgiOutputBuffer, maxBufferCapacity);
+    trimCapacity(_cgiInputCopy, maxBufferCapacity);
+    trimCapacity(_cgiWriteBuffer, maxBufferCapacity);
+}
+
 const std::string& Client::getReceiveBuffer() const { return _receiveBuffer; }
-const std::string& Client::getSendBuffer() const { return _sendBuffer; }
+const SendBuffer& Client::getSendBuffer() const { return _sendBuffer; }
 void Client::clearReceiveBuffer() { _receiveBuffer.clear(); }
 void Client::clearSendBuffer() { _sendBuffer.clear(); }
-void Client::appendToSendBuffer(const std::string& data) { _sendBuffer += data; }
+void Client::appendToSendBuffer(const std::string& data) { _sendBuffer.append(data); }
+
+// Replace whatever is queued with the current response. The header block
+// and the body are queued as separate segments and go out together with
+// one gather write, so the body is never concatenated with the headers.
+// A file-backed body is queued as a file region for sendfile(), a shared
+// (cached) body by reference.
+void Client::_queueResponse(bool includeBody) {
+    std::string headers = _response.toString(false);
+    _sendBuffer.clear();
+    _sendBuffer.appendOwned(headers);
+    if (includeBody) {
+        if (!_response.getBodyParts().empty()) {
+            _queueBodyParts();
+            return;
+        }
+        if (_response.hasFileBody()) {
+            off_t offset;
+            size_t length;
+            int fd = _response.detachFile(offset, length);
+            if (fd >= 0) _sendBuffer.appendFile(fd, offset, length);
+            return;
+        }
+        if (_response.hasSharedBody()) {
+            _sendBuffer.appendShared(_response.getSharedBody(), _response.getSharedOffset(),
+                                     _response.getContentLength());
+            return;
+        }
+        std::string body;
+        _response.releaseBody(body);
+        _sendBuffer.appendOwned(body);
+    }
+}
+
+// multipart/byteranges: the framing of each part goes out from memory, the
+// part itself as a region of the file (or a slice of the shared body)
+void Client::_queueBodyParts() {
+    const std::vector<Response::BodyPart>& parts = _response.getBodyParts();
+    const std::string& trailer = _response.getBodyPartsTrailer();
+    if (_response.hasSharedBody()) {
+        for (size_t i = 0; i < parts.size(); ++i) {
+            _sendBuffer.append(parts[i].header);
+            _sendBuffer.appendShared(_response.getSharedBody(), parts[i].offset, parts[i].length);
+        }
+        _sendBuffer.append(trailer);
+        return;
+    }
+
+    // Each queued region owns an fd: the last part takes the response's own
+    off_t offset;
+    size_t length;
+    int fd = _response.detachFile(offset, length);
+    for (size_t i = 0; i < parts.size() && fd >= 0; ++i) {
+        int partFd = (i + 1 < parts.size()) ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : fd;
+        if (partFd < 0) {
+            Logger::error("Failed to duplicate file descriptor: " + std::string(strerror(errno)));
+            ::close(fd);
+            return;
+        }
+        _sendBuffer.append(parts[i].header);
+        _sendBuffer.appendFile(partFd, (off_t)parts[i].offset, parts[i].length);
+    }
+    _sendBuffer.append(trailer);
+}
 
 void Client::_applyBonusFeatures() {
     // 1. Cookie support - parse request cookies and set response cookies
@@ -1310,45 +1757,304 @@ void Client::_applySessionManagement() {
     Logger::debug("Session created: " + sessionId);
 }
 
-void Client::_applyCompression() {
+// Whether a GET/HEAD body of this type and size will be compressed for the
+// current request, and with which encoding
+Compression::CompressionType Client::_negotiateCompression(const std::string& contentType, size_t length) const {
     // Only consider compression for GET/HEAD to avoid altering CGI/POST bodies
     if (_request.getMethod() != "GET" && _request.getMethod() != "HEAD") {
         Logger::debug("Skipping compression for non-GET/HEAD method");
-        return;
+        return Compression::NONE;
     }
+    return _selectCompression(contentType, length);
+}
 
+// The encoding the client accepts for a body of this type and size
+// (`length` may be npos when not known yet)
+Compression::CompressionType Client::_selectCompression(const std::string& contentType, size_t length) const {
     std::string acceptEncoding = _request.getHeader("accept-encoding");
     Logger::debug("Accept-Encoding header: '" + acceptEncoding + "'");
     if (acceptEncoding.empty()) {
         Logger::debug("No Accept-Encoding header - skipping compression");
-        return;
+        return Compression::NONE;
     }
-    
-    std::string contentType = _response.getHeader("content-type");
-    std::string content = _response.getBody();
 
+    // A client refusing identity gets a compressed body whatever its size
+    // or type, when it accepts any coding at all
+    if (!Compression::shouldCompress(contentType, length, _compression) &&
+        Compression::acceptsIdentity(acceptEncoding)) {
+        return Compression::NONE;
+    }
+    return Compression::getAcceptedCompression(acceptEncoding);
+}
+
+// Variant cache key of the current body: the encoding and level, the entity
+// tag (inode, size and mtime of a static file) and where the bytes came
+// from. Empty when the body's variants are not cached.
+std::string Client::_variantKey(Compression::CompressionType type, const std::string& etag) const {
+    if (!_variantCache || etag.empty()) return "";
+    return Compression::getEncodingHeader(type) + "/" + Utils::intToString(_compression.level) + " " + etag + " " +
+           (_servedPath.empty() ? _request.getUri() : _servedPath);
+}
+
+// HEAD: the headers a GET would get if it compresses the file. The length
+// is only known from a cached variant; otherwise GET sizes (or chunks) the
+// body as it is made, and HEAD sends no Content-Length.
+void Client::_describeCompression(Response& response, const std::string& mimeType, size_t size) {
+    Compression::CompressionType type = _negotiateCompression(mimeType, size);
+    if (type == Compression::NONE || size == 0) return;
+    // A file not held in memory is compressed as a chunked stream: HTTP/1.1
+    if (_request.getVersion() != "HTTP/1.1" && !(_contentCache && _contentCache->holdsInMemory(size))) return;
+
+    SharedBuffer variant;
+    if (_variantCache && _variantCache->peek(_variantKey(type, response.getHeader("ETag")), variant)) {
+        response.setHeader("Content-Length", Utils::sizeToString(variant.size()));
+    } else {
+        response.removeHeader("Content-Length");
+    }
+    response.setHeader("Content-Encoding", Compression::getEncodingHeader(type));
+    varyOnAcceptEncoding(response);
+}
+
+void Client::_applyCompression() {
     // Avoid compressing already-encoded responses
-    if (!_response.getHeader("content-encoding").empty()) {
+    if (!_response.getHeaderCI("content-encoding").empty()) {
         Logger::debug("Response already encoded - skipping compression");
         return;
     }
 
-    if (content.length() > 100 &&
-        (contentType.find("text/") == 0 || 
-         contentType.find("application/") == 0 ||
-         contentType.empty())) {
+    // A Content-Range counts the bytes of the identity body
+    if (_response.getStatusCode() == HTTP_PARTIAL_CONTENT) return;
+
+    // Nothing to encode without body bytes, and nothing may be cached under
+    // the key a GET of the same file looks up
+    int status = _response.getStatusCode();
+    if (_request.getMethod() == "HEAD" || status == HTTP_NO_CONTENT || status == HTTP_NOT_MODIFIED ||
+        _response.getContentLength() == 0) {
+        return;
+    }
+
+    std::string contentType = _response.getHeaderCI("content-type");
+    Compression::CompressionType type = _negotiateCompression(contentType, _response.getContentLength());
+    if (type != Compression::NONE ||
+        (_request.getMethod() == "GET" &&
+         Compression::shouldCompress(contentType, _response.getContentLength(), _compression))) {
+        varyOnAcceptEncoding(_response);
+    }
+    if (type == Compression::NONE) return;
+    std::string encoding = Compression::getEncodingHeader(type);
+
+    // Large bodies go to the worker pool rather than stall this loop
+    bool offload = _workerPool && !_response.hasFileBody() && _response.getContentLength() >= OFFLOAD_MIN_LENGTH;
+
+    // A body with an entity tag is the same bytes for as long as the tag
+    // holds: its compressed form is cached
+    std::string key = _variantKey(type, _response.getHeaderCI("etag"));
+    if (!key.empty()) {
+        SharedBuffer variant;
+        bool owner;
+        if (_variantCache->acquire(key, variant, owner)) {
+            _response.setSharedBody(variant);
+            _response.setHeader("Content-Encoding", encoding);
+            Logger::debug("Applied cached compression: " + encoding);
+            return;
+        }
+        if (!owner) key.clear(); // being made elsewhere: ours goes uncached
+    }
+
+    // A file too large for the content cache is compressed as it is sent,
+    // in chunks: that takes a chunked response, so HTTP/1.1
+    if (_response.hasFileBody()) {
+        if (!key.empty()) _variantCache->abandon(key);
+        if (_request.getVersion() != "HTTP/1.1") return;
+        off_t offset;
+        size_t length;
+        int fd = _response.detachFile(offset, length);
+        if (fd >= 0 && _startEncodedBody(type, fd, offset, length)) {
+            _response.setBody("");
+            _response.removeHeader("Content-Length");
+            _response.setHeader("Transfer-Encoding", "chunked");
+            _response.setHeader("Content-Encoding", encoding);
+            Logger::debug("Streaming compression: " + encoding);
+        }
+        return;
+    }
+
+    if (offload && _offloadCompression(type, key)) return;
 
-        Compression::CompressionType type = Compression::getAcceptedCompression(acceptEncoding);
-        if (type != Compression::NONE) {
-            std::string compressed = Compression::compress(content, type);
-            if (!compressed.empty()) {
-                _response.setBody(compressed);
-                _response.setHeader("Content-Encoding", Compression::getEncodingHeader(type));
-                _response.setHeader("Content-Length", Utils::intToString((int)compressed.length()));
-                Logger::debug("Applied compression: " + Compression::getEncodingHeader(type));
+    // The compressor works on memory
+    std::string compressed;
+    unsigned long long startedMicros = Utils::threadCpuMicros();
+    size_t length;
+    const char* content = _response.getBodyData(length);
+    if (content) compressed = Compression::compress(content, length, type, _compression.level);
+    if (compressed.empty()) {
+        if (!key.empty()) _variantCache->abandon(key);
+        return;
+    }
+    if (!key.empty()) {
+        SharedBuffer variant(compressed);
+        _variantCache->store(key, variant, Utils::threadCpuMicros() - startedMicros);
+        _response.setSharedBody(variant);
+    } else {
+        _response.setBody(compressed);
+    }
+    _response.setHeader("Content-Encoding", encoding);
+    Logger::debug("Applied compression: " + encoding);
+}
+
+// Hand the body to the worker pool; the response stays as it is (a shared
+// body, so the job only takes a reference) until finishJob() swaps in the
+// compressed bytes. False when the pool cannot take more work.
+bool Client::_offloadCompression(Compression::CompressionType type, const std::string& key) {
+    if (!_response.hasSharedBody()) {
+        std::string body;
+        _response.releaseBody(body);
+        SharedBuffer shared(body);
+        _response.setSharedBody(shared);
+    }
+    size_t length;
+    _response.getBodyData(length);
+    Compression::Job* job = new Compression::Job(_response.getSharedBody(), _response.getSharedOffset(), length, type,
+                                                 _compression.level);
+    job->owner = this;
+    if (!_workerPool->submit(job, _completions)) {
+        delete job;
+        return false;
+    }
+    _job = job;
+    _jobKey = key;
+    return true;
+}
+
+void Client::finishJob(WorkerPool::Job* done) {
+    Compression::Job* job = static_cast<Compression::Job*>(done);
+    _job = NULL;
+    if (!job->output.empty()) {
+        std::string encoding = Compression::getEncodingHeader(job->type);
+        SharedBuffer variant(job->output);
+        if (!_jobKey.empty()) _variantCache->store(_jobKey, variant, job->cpuMicros);
+        _response.setSharedBody(variant);
+        _response.setHeader("Content-Encoding", encoding);
+        Logger::debug("Applied compression on the worker pool: " + encoding + ", waited " +
+                      Utils::intToString((int)((job->startedAt - job->submittedAt) / 1000)) + " ms");
+    } else if (!_jobKey.empty()) {
+        // Failed, or the pool stopped first: the body goes out as it is
+        _variantCache->abandon(_jobKey);
+    }
+    _jobKey.clear();
+    _queueResponse(_request.getMethod() != "HEAD");
+    _state = SENDING_RESPONSE;
+}
+
+// Detach from a job still on the pool; the Server deletes it once it is back
+void Client::_cancelJob() {
+    if (!_job) return;
+    _job->owner = NULL;
+    _job = NULL;
+    if (!_jobKey.empty() && _variantCache) _variantCache->abandon(_jobKey);
+    _jobKey.clear();
+}
+
+// Set up a streamed compressed body; takes ownership of `fd` (-1 for CGI
+// output, which is fed in as it arrives)
+bool Client::_startEncodedBody(Compression::CompressionType type, int fd, off_t offset, size_t length) {
+    _discardEncoder();
+    _encoder = new BodyEncoder();
+    _encoder->fd = fd;
+    _encoder->offset = offset;
+    _encoder->remaining = length;
+    if (!_encoder->stream.begin(type, _compression.level)) {
+        _discardEncoder();
+        return false;
+    }
+    return true;
+}
+
+// Read and compress the next blocks of the file until there is output to
+// send; the final chunk goes out once the whole region has been read
+void Client::_pumpEncodedFile() {
+    char block[STREAM_BLOCK_SIZE];
+    std::string out;
+    while (_encoder && out.empty()) {
+        if (_encoder->remaining > 0) {
+            ssize_t n = pread(_encoder->fd, block, std::min(_encoder->remaining, sizeof(block)), _encoder->offset);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                Logger::error("File body ended early, closing connection");
+                _discardEncoder();
+                _state = ERROR_STATE;
+                return;
             }
+            _encoder->offset += n;
+            _encoder->remaining -= n;
+            if (!_encoder->stream.write(block, n, out)) break;
         }
+        if (_encoder->remaining == 0) {
+            _queueChunk(out); // the last block's output goes ahead of the stream's tail
+            _finishEncodedBody();
+            return;
+        }
+    }
+    if (!_encoder) return;
+    if (out.empty()) {
+        Logger::error("Compression failed mid-body, closing connection");
+        _discardEncoder();
+        _state = ERROR_STATE;
+        return;
+    }
+    _queueChunk(out);
+}
+
+// Compress CGI output on the way out when the client takes an encoding the
+// script has not applied itself; the response becomes chunked
+bool Client::_startCgiEncoding() {
+    if (_request.getVersion() != "HTTP/1.1") return false;
+    if (!_response.getHeaderCI("content-encoding").empty()) return false;
+    int status = _response.getStatusCode();
+    if (status == HTTP_NO_CONTENT || status == HTTP_NOT_MODIFIED) return false;
+    Compression::CompressionType type = _selectCompression(_response.getHeaderCI("content-type"), std::string::npos);
+    if (type == Compression::NONE || !_startEncodedBody(type, -1, 0, 0)) return false;
+    _response.setHeader("Transfer-Encoding", "chunked");
+    _response.setHeader("Content-Encoding", Compression::getEncodingHeader(type));
+    varyOnAcceptEncoding(_response);
+    return true;
+}
+
+void Client::_encodeCgiOutput(const char* data, size_t length) {
+    std::string out;
+    if (!_encoder->stream.write(data, length, out)) {
+        Logger::error("Compression of CGI output failed");
+        _state = ERROR_STATE;
+        return;
     }
+    _queueChunk(out);
+}
+
+// Queue what the compressor still holds and the last chunk
+void Client::_finishEncodedBody() {
+    if (!_encoder) return;
+    std::string out;
+    if (!_encoder->stream.finish(out)) Logger::error("Failed to finish streaming compression");
+    _queueChunk(out);
+    _sendBuffer.append("0\r\n\r\n", 5);
+    _discardEncoder();
+}
+
+void Client::_discardEncoder() {
+    if (!_encoder) return;
+    if (_encoder->fd >= 0) ::close(_encoder->fd);
+    delete _encoder;
+    _encoder = NULL;
+}
+
+// Queue `data` (left empty) as one chunk of a chunked body
+void Client::_queueChunk(std::string& data) {
+    if (data.empty()) return;
+    std::ostringstream size;
+    size << std::hex << data.size() << "\r\n";
+    _sendBuffer.append(size.str());
+    _sendBuffer.appendOwned(data);
+    _sendBuffer.append("\r\n", 2);
 }
 
 void Client::_applyRangeRequests() {
@@ -1357,24 +2063,41 @@ void Client::_applyRangeRequests() {
     
     // Only apply range requests to file responses
     if (_response.getStatusCode() != 200) return;
-    
+    // A body being compressed on the worker pool goes out whole
+    if (_job) return;
+
+    // Static files resolve their ranges before the body is read
+    // (_serveStaticFile) and advertise it with Accept-Ranges
+    if (_response.hasHeader("Accept-Ranges")) return;
+    if (!_isRangeCurrent(_response)) return;
+
     std::string content = _response.getBody();
     if (content.empty()) return;
     
     Range range;
-    if (range.parseRangeHeader(rangeHeader, content.length())) {
-        if (range.isSingleRange()) {
-            ByteRange firstRange = range.getFirstRange();
-            std::string rangedContent = range.extractRange(content, firstRange);
-            if (!rangedContent.empty()) {
-                _response.setStatusCode(206); // Partial Content
-                _response.setBody(rangedContent);
-                _response.setHeader("Content-Range", range.generateContentRangeHeader(firstRange));
-                _response.setHeader("Content-Length", Utils::intToString(rangedContent.length()));
-                _response.setHeader("Accept-Ranges", "bytes");
-                Logger::debug("Applied range request: " + rangeHeader);
-            }
+    if (!range.parseRangeHeader(rangeHeader, content.length())) {
+        if (Range::isRangeRequest(rangeHeader)) {
+            _response = Response::createErrorResponse(HTTP_RANGE_NOT_SATISFIABLE);
+            _response.setHeader("Content-Range", range.generateUnsatisfiedRangeHeader());
         }
-        // Multi-range support could be added here if needed
+        return;
+    }
+    if (range.isSingleRange()) {
+        ByteRange firstRange = range.getFirstRange();
+        std::string rangedContent = range.extractRange(content, firstRange);
+        if (!rangedContent.empty()) {
+            _response.setStatusCode(HTTP_PARTIAL_CONTENT);
+            _response.setBody(rangedContent);
+            _response.setHeader("Content-Range", range.generateContentRangeHeader(firstRange));
+            _response.setHeader("Content-Length", Utils::intToString(rangedContent.length()));
+            _response.setHeader("Accept-Ranges", "bytes");
+            Logger::debug("Applied range request: " + rangeHeader);
+        }
+        return;
     }
+    _response.setStatusCode(HTTP_PARTIAL_CONTENT);
+    _response.setBody(range.generateMultipartBody(content, _response.getHeader("Content-Type")));
+    _response.setHeader("Content-Type", range.getMultipartContentType());
+    _response.setHeader("Accept-Ranges", "bytes");
+    Logger::debug("Applied multi-range request: " + rangeHeader);
 }
@@ -0,0 +1,85 @@
+#include "ClientPool.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+#include <functional>
+
+ClientPool::ClientPool(size_t capacity, size_t bufferCapacity)
+    : _capacity(capacity), _slabbed(0), _bufferCapacity(bufferCapacity),
+      _hits(0), _misses(0), _overflows(0) {
+}
+
+ClientPool::~ClientPool() {
+    for (size_t i = 0; i < _slabs.size(); ++i) {
+        delete[] _slabs[i];
+    }
+}
+
+void ClientPool::configure(size_t capacity, size_t bufferCapacity) {
+    _capacity = capacity;
+    _bufferCapacity = bufferCapacity;
+}
+
+bool ClientPool::_isPooled(const Client* client) const {
+    std::less<const Client*> before;
+    for (size_t i = 0; i < _slabs.size(); ++i) {
+        const Client* first = _slabs[i];
+        if (!before(client, first) && before(client, first + SLAB_SIZE)) return true;
+    }
+    return false;
+}
+
+// Carve another slab into the free list, if the capacity allows
+bool ClientPool::_growSlab() {
+    if (_slabbed >= _capacity) return false;
+    Client* slab = new Client[SLAB_SIZE];
+    _slabs.push_back(slab);
+    _slabbed += SLAB_SIZE;
+    for (size_t i = SLAB_SIZE; i > 0; --i) {
+        _free.push_back(&slab[i - 1]);
+    }
+    return true;
+}
+
+Client* ClientPool::acquire(int fd, int listener) {
+    Client* client;
+    if (!_free.empty()) {
+        ++_hits;
+    } else {
+        ++_misses;
+        if (!_growSlab()) {
+            ++_overflows;
+            client = new Client();
+            client->attach(fd, listener);
+            return client;
+        }
+    }
+    client = _free.back();
+    _free.pop_back();
+    client->attach(fd, listener);
+    return client;
+}
+
+// The caller has already closed the connection
+void ClientPool::release(Client* client) {
+    if (!_isPooled(client)) {
+        delete client;
+        return;
+    }
+    client->recycle(_bufferCapacity);
+    _free.push_back(client);
+}
+
+unsigned long ClientPool::getHits() const {
+    return _hits;
+}
+
+unsigned long ClientPool::getMisses() const {
+    return _misses;
+}
+
+void ClientPool::logStats() const {
+    if (_hits == 0 && _misses == 0) return;
+    Logger::info("Client pool: " + Utils::intToString((int)_hits) + " hits, " + Utils::intToString((int)_misses) +
+                 " misses (" + Utils::intToString((int)_overflows) + " beyond capacity), " +
+                 Utils::intToString((int)_slabbed) + " pooled clients");
+}
@@ -2,47 +2,87 @@
 #include "Utils.hpp"
 #include "Logger.hpp"
 #include <cstring>
+#include <cstdlib>
+
+Compression::Settings::Settings() : level(Z_DEFAULT_COMPRESSION), minLength(GZIP_MIN_LENGTH) {
+}
+
+// Accept-Encoding is a list of `coding;q=value` elements (RFC 9110 12.5.3).
+// A coding not listed takes the q-value of "*" if present, else `unlisted`.
+double Compression::_quality(const std::string& acceptEncoding, const std::string& coding, double unlisted) {
+    double wildcard = -1;
+    std::vector<std::string> elements = Utils::split(Utils::toLowerCase(acceptEncoding), ",");
+    for (size_t i = 0; i < elements.size(); ++i) {
+        std::vector<std::string> params = Utils::split(elements[i], ";");
+        if (params.empty()) continue;
+        std::string name = Utils::trim(params[0]);
+        if (name != coding && name != "*") continue;
+        double q = 1;
+        for (size_t j = 1; j < params.size(); ++j) {
+            std::string param = Utils::trim(params[j]);
+            if (param.compare(0, 2, "q=") != 0) continue;
+            char* end;
+            q = strtod(param.c_str() + 2, &end);
+            if (end == param.c_str() + 2 || q < 0) q = 0;
+            if (q > 1) q = 1;
+        }
+        if (name == coding) return q;
+        wildcard = q;
+    }
+    return wildcard >= 0 ? wildcard : unlisted;
+}
+
+double Compression::getQuality(const std::string& acceptEncoding, const std::string& coding) {
+    // Identity is acceptable unless the header says otherwise
+    return _quality(acceptEncoding, Utils::toLowerCase(coding), coding == "identity" ? 1 : 0);
+}
 
 Compression::CompressionType Compression::getAcceptedCompression(const std::string& acceptEncoding) {
     if (acceptEncoding.empty()) return NONE;
-    
-    std::string lowerEncoding = Utils::toLowerCase(acceptEncoding);
-    
-    if (lowerEncoding.find("gzip") != std::string::npos) {
-        return GZIP;
-    } else if (lowerEncoding.find("deflate") != std::string::npos) {
-        return DEFLATE;
-    }
-    
-    return NONE;
+
+    double gzip = _quality(acceptEncoding, "gzip", 0);
+    double deflate = _quality(acceptEncoding, "deflate", 0);
+    CompressionType best = (gzip >= deflate) ? GZIP : DEFLATE;
+    double bestQuality = std::max(gzip, deflate);
+    if (bestQuality <= 0) return NONE;
+    // Only an explicit preference for identity keeps the body as it is
+    if (_quality(acceptEncoding, "identity", 0) > bestQuality) return NONE;
+    return best;
 }
 
-std::string Compression::compress(const std::string& data, CompressionType type) {
-    switch (type) {
-        case GZIP:
-            return _simpleGzipCompress(data);
-        case DEFLATE:
-            return simpleCompress(data);
-        case NONE:
-        default:
-            return data;
+bool Compression::acceptsIdentity(const std::string& acceptEncoding) {
+    return getQuality(acceptEncoding, "identity") > 0;
+}
+
+std::string Compression::compress(const std::string& data, CompressionType type, int level) {
+    return compress(data.data(), data.size(), type, level);
+}
+
+std::string Compression::compress(const char* data, size_t length, CompressionType type, int level) {
+    if (type == NONE) return std::string(data, length);
+    std::string compressed;
+    Stream stream;
+    if (!stream.begin(type, level) || !stream.write(data, length, compressed) || !stream.finish(compressed)) {
+        Logger::debug("Failed to compress data with " + getEncodingHeader(type));
+        return "";
     }
+    Logger::debug("Compressed with " + getEncodingHeader(type) + ": " + Utils::sizeToString(length) + " -> " +
+                  Utils::sizeToString(compressed.size()) + " bytes");
+    return compressed;
 }
 
-bool Compression::shouldCompress(const std::string& contentType, size_t contentLength) {
-    // Don't compress small files (< 1KB)
-    if (contentLength < 1024) return false;
-    
-    // Don't compress already compressed content
-    if (contentType.find("image/") == 0 ||
-        contentType.find("video/") == 0 ||
-        contentType.find("audio/") == 0 ||
-        contentType.find("application/zip") == 0 ||
-        contentType.find("application/gzip") == 0) {
-        return false;
+bool Compression::shouldCompress(const std::string& contentType, size_t contentLength, const Settings& settings) {
+    if (contentLength < settings.minLength) return false;
+
+    std::string mediaType = Utils::toLowerCase(Utils::trim(contentType.substr(0, contentType.find(';'))));
+    if (settings.types.empty()) return _isCompressible(mediaType);
+
+    // Like nginx, HTML is always in the list
+    if (mediaType == "text/html") return true;
+    for (size_t i = 0; i < settings.types.size(); ++i) {
+        if (settings.types[i] == "*" || settings.types[i] == mediaType) return true;
     }
-    
-    return _isCompressible(contentType);
+    return false;
 }
 
 std::string Compression::getEncodingHeader(CompressionType type) {
@@ -54,6 +94,8 @@ std::string Compression::getEncodingHeader(CompressionType type) {
     }
 }
 
+// The built-in list: text and the textual application types. Already
+// compressed formats (images, video, archives) are never worth it.
 bool Compression::_isCompressible(const std::string& contentType) {
     return (contentType.find("text/") == 0 ||
             contentType.find("application/json") == 0 ||
@@ -62,73 +104,80 @@ bool Compression::_isCompressible(const std::string& contentType) {
             contentType.find("application/xhtml") == 0);
 }
 
-std::string Compression::_simpleGzipCompress(const std::string& data) {
-    z_stream zs;                        
-    memset(&zs, 0, sizeof(zs));
-
-    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
-        Logger::debug("Failed to initialize gzip compression");
-        return data;
-    }
-
-    zs.next_in = (Bytef*)data.data();
-    zs.avail_in = data.size();
+Compression::Job::Job(const SharedBuffer& input, size_t offset, size_t length, CompressionType type, int level)
+    : input(input), offset(offset), length(length), type(type), level(level), cpuMicros(0) {
+}
 
-    int ret;
-    char outbuffer[32768];
-    std::string compressed;
+void Compression::Job::run() {
+    unsigned long long started = Utils::threadCpuMicros();
+    output = compress(input.data() + offset, length, type, level);
+    cpuMicros = Utils::threadCpuMicros() - started;
+}
 
-    do {
-        zs.next_out = reinterpret_cast<Bytef*>(outbuffer);
-        zs.avail_out = sizeof(outbuffer);
+Compression::Stream::Stream() : _active(false) {
+    memset(&_zs, 0, sizeof(_zs));
+}
 
-        ret = deflate(&zs, Z_FINISH);
+Compression::Stream::~Stream() {
+    end();
+}
 
-        if (compressed.size() < zs.total_out) {
-            compressed.append(outbuffer, zs.total_out - compressed.size());
-        }
-    } while (ret == Z_OK);
+bool Compression::Stream::begin(CompressionType type, int level) {
+    end();
+    if (type == NONE) return false;
+    // gzip wraps the deflate data in a gzip header and trailer; HTTP's
+    // "deflate" is the zlib format
+    int windowBits = (type == GZIP) ? 15 + 16 : 15;
+    memset(&_zs, 0, sizeof(_zs));
+    if (deflateInit2(&_zs, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        Logger::error("Failed to initialize streaming compression");
+        return false;
+    }
+    _active = true;
+    return true;
+}
 
-    deflateEnd(&zs);
+bool Compression::Stream::_deflate(int flush, std::string& out) {
+    char buffer[16384];
+    int ret;
+    do {
+        _zs.next_out = reinterpret_cast<Bytef*>(buffer);
+        _zs.avail_out = sizeof(buffer);
+        ret = deflate(&_zs, flush);
+        if (ret == Z_STREAM_ERROR) return false;
+        out.append(buffer, sizeof(buffer) - _zs.avail_out);
+    } while (_zs.avail_out == 0 && ret != Z_STREAM_END);
+    return flush != Z_FINISH || ret == Z_STREAM_END;
+}
 
-    if (ret != Z_STREAM_END) {
-        Logger::debug("Failed to compress data with gzip");
-        return data;
+bool Compression::Stream::write(const char* data, size_t length, std::string& out) {
+    if (!_active) return false;
+    // avail_in is an unsigned int: feed very large blocks in slices
+    while (length > 0) {
+        size_t slice = std::min(length, (size_t)1 << 30);
+        _zs.next_in = (Bytef*)data;
+        _zs.avail_in = (uInt)slice;
+        if (!_deflate(Z_NO_FLUSH, out)) return false;
+        data += slice;
+        length -= slice;
     }
+    return true;
+}
 
-    Logger::debug("Real GZIP compression applied: " + Utils::intToString(data.length()) + " -> " + Utils::intToString(compressed.length()) + " bytes");
-    return compressed;
+bool Compression::Stream::finish(std::string& out) {
+    if (!_active) return false;
+    _zs.next_in = NULL;
+    _zs.avail_in = 0;
+    bool ok = _deflate(Z_FINISH, out);
+    end();
+    return ok;
 }
 
-std::string Compression::simpleCompress(const std::string& data) {
-    // Simple run-length encoding for demonstration
-    // This is NOT real compression, just for bonus feature demonstration
-    std::string compressed;
-    
-    if (data.empty()) return compressed;
-    
-    char current = data[0];
-    int count = 1;
-    
-    for (size_t i = 1; i < data.length(); ++i) {
-        if (data[i] == current && count < 255) {
-            count++;
-        } else {
-            compressed += current;
-            compressed += static_cast<char>(count);
-            current = data[i];
-            count = 1;
-        }
-    }
-    
-    compressed += current;
-    compressed += static_cast<char>(count);
-    
-    // Only return compressed if it's actually smaller, otherwise add a small marker
-    if (compressed.length() < data.length()) {
-        return compressed;
-    } else {
-        // For demo purposes, add a small marker to show compression was attempted
-        return "COMP:" + data;
-    }
+void Compression::Stream::end() {
+    if (_active) deflateEnd(&_zs);
+    _active = false;
+}
+
+bool Compression::Stream::isActive() const {
+    return _active;
 }
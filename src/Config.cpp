@@ -2,21 +2,64 @@
 #include "Utils.hpp"
 #include "Logger.hpp"
 
-Config::Config() {
+Config::Config() : _workerProcesses(1), _workerThreads(1), _acceptBudget(ACCEPT_BUDGET),
+                   _workerConnections(MAX_CLIENTS), _clientPoolBufferSize(BUFFER_SIZE), _keepAliveWatermark(0),
+                   _keepAliveWatermarkPercent(KEEPALIVE_WATERMARK_PERCENT), _memoryLimit(0),
+                   _retryAfter(RETRY_AFTER_SECONDS),
+                   _openFileCache(OPEN_FILE_CACHE_ENTRIES), _openFileCacheValid(OPEN_FILE_CACHE_VALID_MS),
+                   _contentCache(CONTENT_CACHE_BUDGET), _contentCacheMaxEntry(CONTENT_CACHE_MAX_ENTRY),
+                   _compressionCache(VARIANT_CACHE_BUDGET),
+                   _threadPool(THREAD_POOL_THREADS), _threadPoolMaxQueue(THREAD_POOL_MAX_QUEUE) {
 }
 
-Config::Config(const std::string& configFile) : _configFile(configFile) {
+Config::Config(const std::string& configFile) : _configFile(configFile), _workerProcesses(1), _workerThreads(1),
+                                                  _acceptBudget(ACCEPT_BUDGET), _workerConnections(MAX_CLIENTS),
+                                                  _clientPoolBufferSize(BUFFER_SIZE), _keepAliveWatermark(0),
+                                                  _keepAliveWatermarkPercent(KEEPALIVE_WATERMARK_PERCENT),
+                                                  _memoryLimit(0), _retryAfter(RETRY_AFTER_SECONDS),
+                                                  _openFileCache(OPEN_FILE_CACHE_ENTRIES),
+                                                  _openFileCacheValid(OPEN_FILE_CACHE_VALID_MS),
+                                                  _contentCache(CONTENT_CACHE_BUDGET),
+                                                  _contentCacheMaxEntry(CONTENT_CACHE_MAX_ENTRY),
+                                                  _compressionCache(VARIANT_CACHE_BUDGET),
+                                                  _threadPool(THREAD_POOL_THREADS),
+                                                  _threadPoolMaxQueue(THREAD_POOL_MAX_QUEUE) {
     loadConfig(configFile);
 }
 
-Config::Config(const Config& other) {
+Config::Config(const Config& other) : _workerProcesses(1), _workerThreads(1), _acceptBudget(ACCEPT_BUDGET),
+                                      _workerConnections(MAX_CLIENTS), _clientPoolBufferSize(BUFFER_SIZE),
+                                      _keepAliveWatermark(0), _keepAliveWatermarkPercent(KEEPALIVE_WATERMARK_PERCENT),
+                                      _memoryLimit(0), _retryAfter(RETRY_AFTER_SECONDS),
+                                      _openFileCache(OPEN_FILE_CACHE_ENTRIES),
+                                      _openFileCacheValid(OPEN_FILE_CACHE_VALID_MS),
+                                      _contentCache(CONTENT_CACHE_BUDGET), _contentCacheMaxEntry(CONTENT_CACHE_MAX_ENTRY),
+                                      _compressionCache(VARIANT_CACHE_BUDGET),
+                                      _threadPool(THREAD_POOL_THREADS), _threadPoolMaxQueue(THREAD_POOL_MAX_QUEUE) {
     *this = other;
 }
 
 Config& Config::operator=(const Config& other) {
     if (this != &other) {
         _servers = other._servers;
+        _buildListeners(false);
         _configFile = other._configFile;
+        _workerProcesses = other._workerProcesses;
+        _workerThreads = other._workerThreads;
+        _acceptBudget = other._acceptBudget;
+        _workerConnections = other._workerConnections;
+        _clientPoolBufferSize = other._clientPoolBufferSize;
+        _keepAliveWatermark = other._keepAliveWatermark;
+        _keepAliveWatermarkPercent = other._keepAliveWatermarkPercent;
+        _memoryLimit = other._memoryLimit;
+        _retryAfter = other._retryAfter;
+        _openFileCache = other._openFileCache;
+        _openFileCacheValid = other._openFileCacheValid;
+        _contentCache = other._contentCache;
+        _contentCacheMaxEntry = other._contentCacheMaxEntry;
+        _compressionCache = other._compressionCache;
+        _threadPool = other._threadPool;
+        _threadPoolMaxQueue = other._threadPoolMaxQueue;
     }
     return *this;
 }
@@ -27,6 +70,23 @@ Config::~Config() {
 void Config::loadConfig(const std::string& filename) {
     _configFile = filename;
     _servers.clear();
+    _listeners.clear();
+    _workerProcesses = 1;
+    _workerThreads = 1;
+    _acceptBudget = ACCEPT_BUDGET;
+    _workerConnections = MAX_CLIENTS;
+    _clientPoolBufferSize = BUFFER_SIZE;
+    _keepAliveWatermark = 0;
+    _keepAliveWatermarkPercent = KEEPALIVE_WATERMARK_PERCENT;
+    _memoryLimit = 0;
+    _retryAfter = RETRY_AFTER_SECONDS;
+    _openFileCache = OPEN_FILE_CACHE_ENTRIES;
+    _openFileCacheValid = OPEN_FILE_CACHE_VALID_MS;
+    _contentCache = CONTENT_CACHE_BUDGET;
+    _contentCacheMaxEntry = CONTENT_CACHE_MAX_ENTRY;
+    _compressionCache = VARIANT_CACHE_BUDGET;
+    _threadPool = THREAD_POOL_THREADS;
+    _threadPoolMaxQueue = THREAD_POOL_MAX_QUEUE;
     
     if (!Utils::fileExists(filename)) {
         Logger::warn("Config file not found: " + filename + ", using default configuration");
@@ -39,6 +99,7 @@ void Config::loadConfig(const std::string& filename) {
         defaultServer.root = "./www";
         defaultServer.index = "index.html";
         defaultServer.maxBodySize = MAX_BODY_SIZE;
+        defaultServer.isDefault = false;
         
         // Default location
         Location defaultLocation("/");
@@ -49,8 +110,10 @@ void Config::loadConfig(const std::string& filename) {
         defaultLocation.addAllowedMethod("DELETE");
         defaultLocation.setAutoindex(true);
         defaultServer.locations.push_back(defaultLocation);
+        defaultServer.locationIndex.build(defaultServer.locations);
         
         _servers.push_back(defaultServer);
+        _buildListeners(true);
         return;
     }
     
@@ -64,6 +127,7 @@ void Config::loadConfig(const std::string& filename) {
     if (_servers.empty()) {
         throw std::runtime_error("No server blocks found in configuration");
     }
+    _buildListeners(true);
 }
 
 void Config::_parseConfigFile(const std::string& filename) {
@@ -84,13 +148,156 @@ void Config::_parseConfigFile(const std::string& filename) {
             server.root = "./www";
             server.index = "index.html";
             server.maxBodySize = MAX_BODY_SIZE;
+            server.isDefault = false;
             
             _parseServerBlock(file, server);
+            server.locationIndex.build(server.locations);
             _servers.push_back(server);
+        } else {
+            _parseGlobalDirective(line);
         }
     }
 }
 
+// Directives that live outside of any server block
+void Config::_parseGlobalDirective(const std::string& line) {
+    std::string directive = _parseLine(line);
+    std::vector<std::string> values = _parseValues(line);
+
+    if (directive == "worker_processes") {
+        _workerProcesses = _parseWorkerCount(directive, values);
+    } else if (directive == "worker_threads") {
+        _workerThreads = _parseWorkerCount(directive, values);
+    } else if (directive == "accept_budget") {
+        // Upper bound on connections accepted from one listener per wakeup
+        if (values.empty()) {
+            throw std::runtime_error(directive + " requires a value");
+        }
+        _acceptBudget = Utils::stringToInt(values[0]);
+        if (_acceptBudget < 1) {
+            throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+        }
+    } else if (directive == "worker_connections") {
+        // Connection limit of a serving process; also sizes the Client pool
+        if (values.empty()) {
+            throw std::runtime_error(directive + " requires a value");
+        }
+        _workerConnections = Utils::stringToInt(values[0]);
+        if (_workerConnections < 1) {
+            throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+        }
+    } else if (directive == "client_pool_buffer_size") {
+        // Buffer capacity a pooled Client may keep between connections
+        _clientPoolBufferSize = _parseSize(directive, values);
+    } else if (directive == "keepalive_watermark") {
+        // Above this many connections new responses close the connection.
+        // Either an absolute count or a percentage of worker_connections.
+        if (values.empty()) {
+            throw std::runtime_error(directive + " requires a value");
+        }
+        std::string value = values[0];
+        bool percent = !value.empty() && value[value.length() - 1] == '%';
+        if (percent) value = value.substr(0, value.length() - 1);
+        if (!Utils::isNumber(value) || Utils::stringToInt(value) < 1) {
+            throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+        }
+        _keepAliveWatermark = percent ? 0 : Utils::stringToInt(value);
+        _keepAliveWatermarkPercent = percent ? Utils::stringToInt(value) : 100;
+    } else if (directive == "memory_limit") {
+        // New connections are refused while resident memory exceeds this
+        _memoryLimit = _parseSize(directive, values);
+    } else if (directive == "retry_after") {
+        if (values.empty() || !Utils::isNumber(values[0])) {
+            throw std::runtime_error("Invalid " + directive + " value");
+        }
+        _retryAfter = Utils::stringToInt(values[0]);
+    } else if (directive == "open_file_cache") {
+        // Cached path lookups (stat + open fd) per event loop; 0 or "off" disables
+        if (values.empty()) {
+            throw std::runtime_error(directive + " requires a value");
+        }
+        if (values[0] == "off") {
+            _openFileCache = 0;
+        } else if (Utils::isNumber(values[0])) {
+            _openFileCache = Utils::stringToInt(values[0]);
+        } else {
+            throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+        }
+    } else if (directive == "open_file_cache_valid") {
+        // How long a cached lookup is trusted: N seconds, or Nms
+        if (values.empty()) {
+            throw std::runtime_error(directive + " requires a value");
+        }
+        std::string value = values[0];
+        bool millis = value.size() > 2 && value.substr(value.size() - 2) == "ms";
+        if (millis) value = value.substr(0, value.size() - 2);
+        else if (!value.empty() && value[value.size() - 1] == 's') value = value.substr(0, value.size() - 1);
+        if (!Utils::isNumber(value)) {
+            throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+        }
+        _openFileCacheValid = millis ? Utils::stringToInt(value) : Utils::stringToInt(value) * 1000;
+    } else if (directive == "content_cache") {
+        // Memory for hot file contents, shared by the loop threads of a
+        // process; 0 or "off" disables
+        _contentCache = (!values.empty() && values[0] == "off") ? 0 : _parseSize(directive, values);
+    } else if (directive == "content_cache_max_entry") {
+        // Files above this size are never loaded into the content cache
+        _contentCacheMaxEntry = _parseSize(directive, values);
+    } else if (directive == "compression_cache") {
+        // Memory for compressed response bodies, shared by the loop threads
+        // of a process; 0 or "off" disables
+        _compressionCache = (!values.empty() && values[0] == "off") ? 0 : _parseSize(directive, values);
+    } else if (directive == "thread_pool") {
+        // Threads per process for CPU-heavy work such as compressing large
+        // bodies off the event loops; 0 or "off" does it inline
+        bool off = !values.empty() && (values[0] == "off" || values[0] == "0");
+        _threadPool = off ? 0 : _parseWorkerCount(directive, values);
+    } else if (directive == "thread_pool_max_queue") {
+        // Jobs waiting for a thread; beyond this a loop does the work itself
+        if (values.empty() || !Utils::isNumber(values[0]) || Utils::stringToInt(values[0]) < 1) {
+            throw std::runtime_error("Invalid " + directive + " value");
+        }
+        _threadPoolMaxQueue = Utils::stringToInt(values[0]);
+    }
+}
+
+// Parses the "N|auto" argument shared by worker_processes and worker_threads
+int Config::_parseWorkerCount(const std::string& directive, const std::vector<std::string>& values) {
+    if (values.empty()) {
+        throw std::runtime_error(directive + " requires a value");
+    }
+    if (values[0] == "auto") {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? (int)cpus : 1;
+    }
+    int count = Utils::stringToInt(values[0]);
+    if (count < 1) {
+        throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+    }
+    return count;
+}
+
+// Parses a byte count with an optional K or M suffix
+size_t Config::_parseSize(const std::string& directive, const std::vector<std::string>& values) {
+    if (values.empty()) {
+        throw std::runtime_error(directive + " requires a value");
+    }
+    std::string sizeStr = values[0];
+    size_t multiplier = 1;
+    char suffix = sizeStr.empty() ? '\0' : sizeStr[sizeStr.length() - 1];
+    if (suffix == 'M' || suffix == 'm') {
+        multiplier = 1024 * 1024;
+        sizeStr = sizeStr.substr(0, sizeStr.length() - 1);
+    } else if (suffix == 'K' || suffix == 'k') {
+        multiplier = 1024;
+        sizeStr = sizeStr.substr(0, sizeStr.length() - 1);
+    }
+    if (!Utils::isNumber(sizeStr)) {
+        throw std::runtime_error("Invalid " + directive + " value: " + values[0]);
+    }
+    return Utils::stringToSize(sizeStr) * multiplier;
+}
+
 void Config::_parseServerBlock(std::ifstream& file, ServerBlock& server) {
     std::string line;
     int braceCount = 1;
@@ -131,6 +338,7 @@ void Config::_parseServerBlock(std::ifstream& file, ServerBlock& server) {
                 } else {
                     server.port = Utils::stringToInt(values[0]);
                 }
+                server.isDefault = values.size() > 1 && values[1] == "default_server";
             }
         } else if (directive == "server_name") {
             server.serverNames = values;
@@ -219,10 +427,88 @@ void Config::_parseLocationBlock(std::ifstream& file, Location& location) {
             if (!values.empty()) location.setCgiPath(values[0]);
         } else if (directive == "cgi_ext" || directive == "cgi_extension") {
             if (!values.empty()) location.setCgiExtension(values[0]);
+        } else if (directive == "gzip_static") {
+            if (!values.empty()) {
+                location.setGzipStatic(values[0] == "on" || values[0] == "true");
+            }
+        } else if (directive == "gzip_level") {
+            // zlib level: 1 is fastest, 9 smallest
+            if (values.empty() || !Utils::isNumber(values[0]) || Utils::stringToInt(values[0]) < 1 ||
+                Utils::stringToInt(values[0]) > 9) {
+                throw std::runtime_error("gzip_level must be between 1 and 9");
+            }
+            location.setCompressionLevel(Utils::stringToInt(values[0]));
+        } else if (directive == "gzip_min_length") {
+            location.setCompressionMinLength(_parseSize(directive, values));
+        } else if (directive == "gzip_types") {
+            // Media types compressed besides text/html; "*" for any
+            if (values.empty()) {
+                throw std::runtime_error("gzip_types requires at least one type");
+            }
+            location.setCompressionTypes(values);
+        } else if (directive == "expires") {
+            _parseExpires(values, location);
+        } else if (directive == "add_header") {
+            // add_header Name value...; the value may be quoted and contain spaces
+            if (values.size() < 2) {
+                throw std::runtime_error("add_header requires a name and a value");
+            }
+            std::string value = values[1];
+            for (size_t i = 2; i < values.size(); ++i) value += " " + values[i];
+            if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"') {
+                value = value.substr(1, value.size() - 2);
+            }
+            location.setResponseHeader(values[0], value);
         }
     }
 }
 
+// expires off|epoch|max|TIME, with TIME in seconds or suffixed s/m/h/d.
+// Everything is rendered here, so serving a file only copies the strings.
+// A relative time becomes Cache-Control: max-age alone: HTTP/1.1 caches
+// prefer it over Expires, which would need a fresh date on every response.
+void Config::_parseExpires(const std::vector<std::string>& values, Location& location) {
+    if (values.empty()) {
+        throw std::runtime_error("expires requires a value");
+    }
+    const std::string& value = values[0];
+    if (value == "off") {
+        location.removeResponseHeader("Expires");
+        location.removeResponseHeader("Cache-Control");
+        return;
+    }
+    if (value == "epoch") {
+        location.setResponseHeader("Expires", "Thu, 01 Jan 1970 00:00:01 GMT");
+        location.setResponseHeader("Cache-Control", "no-cache");
+        return;
+    }
+    if (value == "max") {
+        location.setResponseHeader("Expires", "Thu, 31 Dec 2037 23:55:55 GMT");
+        location.setResponseHeader("Cache-Control", "max-age=315360000");
+        return;
+    }
+
+    std::string number = value;
+    bool negative = !number.empty() && number[0] == '-';
+    if (negative) number = number.substr(1);
+    long multiplier = 1;
+    char suffix = number.empty() ? '\0' : number[number.size() - 1];
+    if (suffix == 's' || suffix == 'm' || suffix == 'h' || suffix == 'd') {
+        multiplier = suffix == 'm' ? 60 : suffix == 'h' ? 3600 : suffix == 'd' ? 86400 : 1;
+        number = number.substr(0, number.size() - 1);
+    }
+    if (!Utils::isNumber(number)) {
+        throw std::runtime_error("Invalid expires value: " + value);
+    }
+    long seconds = Utils::stringToInt(number) * multiplier;
+    location.removeResponseHeader("Expires");
+    if (negative) {
+        location.setResponseHeader("Cache-Control", "no-cache");
+    } else {
+        location.setResponseHeader("Cache-Control", "max-age=" + Utils::sizeToString((size_t)seconds));
+    }
+}
+
 std::string Config::_parseLine(const std::string& line) {
     size_t end = line.find_first_of(" \t");
     return (end != std::string::npos) ? line.substr(0, end) : line;
@@ -251,6 +537,72 @@ Config::ServerBlock Config::getDefaultServer() const {
     return _servers.empty() ? ServerBlock() : _servers[0];
 }
 
+const std::vector<Config::Listener>& Config::getListeners() const {
+    return _listeners;
+}
+
+int Config::getWorkerProcesses() const {
+    return _workerProcesses;
+}
+
+int Config::getWorkerThreads() const {
+    return _workerThreads;
+}
+
+int Config::getAcceptBudget() const {
+    return _acceptBudget;
+}
+
+int Config::getWorkerConnections() const {
+    return _workerConnections;
+}
+
+size_t Config::getClientPoolBufferSize() const {
+    return _clientPoolBufferSize;
+}
+
+int Config::getKeepAliveWatermark() const {
+    if (_keepAliveWatermark > 0) return _keepAliveWatermark;
+    int watermark = (int)((long long)_workerConnections * _keepAliveWatermarkPercent / 100);
+    return watermark > 0 ? watermark : 1;
+}
+
+size_t Config::getMemoryLimit() const {
+    return _memoryLimit;
+}
+
+int Config::getRetryAfter() const {
+    return _retryAfter;
+}
+
+int Config::getOpenFileCache() const {
+    return _openFileCache;
+}
+
+int Config::getOpenFileCacheValid() const {
+    return _openFileCacheValid;
+}
+
+size_t Config::getContentCache() const {
+    return _contentCache;
+}
+
+size_t Config::getContentCacheMaxEntry() const {
+    return _contentCacheMaxEntry;
+}
+
+size_t Config::getCompressionCache() const {
+    return _compressionCache;
+}
+
+int Config::getThreadPool() const {
+    return _threadPool;
+}
+
+int Config::getThreadPoolMaxQueue() const {
+    return _threadPoolMaxQueue;
+}
+
 Config::ServerIterator Config::begin() const {
     return ServerIterator(_servers.begin());
 }
@@ -273,47 +625,85 @@ size_t Config::getMaxBodySize(const ServerBlock& server) { return server.maxBody
 const std::map<int, std::string>& Config::getErrorPages(const ServerBlock& server) { return server.errorPages; }
 const std::vector<Location>& Config::getLocations(const ServerBlock& server) { return server.locations; }
 
-const Config::ServerBlock* Config::findServer(const std::string& host, int port, const std::string& serverName) const {
-    // First pass: exact match
+// Group the server blocks by listen address and index each group by name.
+// Only the load reports conflicts; copies rebuild an already checked table.
+void Config::_buildListeners(bool validate) {
+    _listeners.clear();
     for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].host == host && _servers[i].port == port) {
-            if (serverName.empty()) {
-                return &_servers[i];
+        const ServerBlock& server = _servers[i];
+        size_t index = 0;
+        while (index < _listeners.size() &&
+               (_listeners[index].host != server.host || _listeners[index].port != server.port)) {
+            ++index;
+        }
+        if (index == _listeners.size()) {
+            Listener listener;
+            listener.host = server.host;
+            listener.port = server.port;
+            listener.servers = 0;
+            listener.defaultServer = &server;
+            _listeners.push_back(listener);
+        }
+
+        Listener& listener = _listeners[index];
+        std::string address = server.host + ":" + Utils::intToString(server.port);
+        ++listener.servers;
+        if (server.isDefault) {
+            if (validate && listener.defaultServer != &server && listener.defaultServer->isDefault) {
+                throw std::runtime_error("Duplicate default_server for " + address);
             }
-            
-            const std::vector<std::string>& names = _servers[i].serverNames;
-            for (size_t j = 0; j < names.size(); ++j) {
-                if (names[j] == serverName) {
-                    return &_servers[i];
-                }
+            listener.defaultServer = &server;
+        }
+        for (size_t j = 0; j < server.serverNames.size(); ++j) {
+            std::string name = Utils::toLowerCase(server.serverNames[j]);
+            if (!listener.names.insert(std::make_pair(name, &server)).second && validate) {
+                Logger::warn("Conflicting server name \"" + name + "\" on " + address + ", ignored");
             }
         }
     }
-    
-    // Second pass: port match only (default for host:port)
-    for (size_t i = 0; i < _servers.size(); ++i) {
-        if (_servers[i].port == port) {
-            return &_servers[i];
-        }
+}
+
+// "Example.COM:8080" -> "example.com"; "[::1]:8080" -> "[::1]"
+static std::string hostName(const std::string& header) {
+    std::string host = Utils::toLowerCase(Utils::trim(header));
+    size_t end;
+    if (!host.empty() && host[0] == '[') {
+        end = host.find(']');
+        end = (end == std::string::npos) ? host.size() : end + 1;
+    } else {
+        end = host.find(':');
+        if (end == std::string::npos) end = host.size();
     }
-    
-    // Return first server as ultimate default
-    return _servers.empty() ? NULL : &_servers[0];
+    host.erase(end);
+    if (!host.empty() && host[host.size() - 1] == '.') host.erase(host.size() - 1);
+    return host;
 }
 
-const Location* Config::findLocation(const ServerBlock& server, const std::string& uri) const {
-    const Location* bestMatch = NULL;
-    size_t bestMatchLength = 0;
-    
-    for (size_t i = 0; i < server.locations.size(); ++i) {
-        if (server.locations[i].matches(uri)) {
-            size_t pathLength = server.locations[i].getPath().length();
-            if (pathLength > bestMatchLength) {
-                bestMatch = &server.locations[i];
-                bestMatchLength = pathLength;
+// Exact name first, then wildcards from the most specific down
+// (a.b.example.com tries *.b.example.com, *.example.com, *.com), else the
+// listener's default server
+const Config::ServerBlock& Config::findServer(int listener, const std::string& hostHeader) const {
+    static const ServerBlock none = ServerBlock();
+    if (listener < 0 || (size_t)listener >= _listeners.size()) {
+        return _servers.empty() ? none : _servers[0];
+    }
+
+    const Listener& entry = _listeners[listener];
+    if (!entry.names.empty()) {
+        std::string name = hostName(hostHeader);
+        if (!name.empty()) {
+            std::map<std::string, const ServerBlock*>::const_iterator it = entry.names.find(name);
+            if (it != entry.names.end()) return *it->second;
+            for (size_t dot = name.find('.'); dot != std::string::npos; dot = name.find('.', dot + 1)) {
+                it = entry.names.find("*" + name.substr(dot));
+                if (it != entry.names.end()) return *it->second;
             }
         }
     }
-    
-    return bestMatch;
+    return *entry.defaultServer;
+}
+
+const Location* Config::findLocation(const ServerBlock& server, const std::string& uri) const {
+    int index = server.locationIndex.match(uri);
+    return index == LocationTrie::NONE ? NULL : &server.locations[index];
 }
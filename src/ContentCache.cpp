@@ -0,0 +1,141 @@
+#include "ContentCache.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+
+ContentCache::ContentCache(size_t budget, size_t maxEntrySize)
+    : _budget(budget), _maxEntrySize(maxEntrySize), _hits(0), _misses(0), _evictions(0) {
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+ContentCache::~ContentCache() {
+    pthread_mutex_destroy(&_mutex);
+}
+
+// Only before the loop threads start: the limits are read without the lock
+void ContentCache::configure(size_t budget, size_t maxEntrySize) {
+    clear();
+    _budget = budget;
+    _maxEntrySize = maxEntrySize;
+}
+
+// A hit moves the entry to the front; a stale entry is dropped
+bool ContentCache::_find(Store& store, const FileCache::Entry& file, SharedBuffer& content) {
+    EntryIndex::iterator found = store.index.find(file.path);
+    if (found == store.index.end()) return false;
+    EntryList::iterator it = found->second;
+    if (it->inode == file.st.st_ino && it->device == file.st.st_dev && it->mtime == file.st.st_mtime &&
+        it->content.size() == (size_t)file.st.st_size) {
+        store.entries.splice(store.entries.begin(), store.entries, it);
+        content = it->content;
+        return true;
+    }
+    // Changed on disk: the old bytes must not be served again
+    _erase(store, it);
+    return false;
+}
+
+void ContentCache::_insert(Store& store, const FileCache::Entry& file, const SharedBuffer& content) {
+    EntryIndex::iterator found = store.index.find(file.path);
+    if (found != store.index.end()) _erase(store, found->second);
+    store.entries.push_front(Entry());
+    Entry& entry = store.entries.front();
+    entry.path = file.path;
+    entry.content = content;
+    entry.inode = file.st.st_ino;
+    entry.device = file.st.st_dev;
+    entry.mtime = file.st.st_mtime;
+    store.index[entry.path] = store.entries.begin();
+    store.bytes += content.size();
+}
+
+void ContentCache::_erase(Store& store, EntryList::iterator it) {
+    store.bytes -= it->content.size();
+    store.index.erase(it->path);
+    store.entries.erase(it);
+}
+
+bool ContentCache::_readFile(const FileCache::Entry& file, std::string& out) {
+    size_t length = (size_t)file.st.st_size;
+    out.assign(length, '\0');
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(file.fd, &out[done], length - done, (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+bool ContentCache::accepts(const FileCache::Entry& file) const {
+    return _budget > 0 && file.error == 0 && file.fd >= 0 && S_ISREG(file.st.st_mode) &&
+           (size_t)file.st.st_size <= _maxEntrySize && (size_t)file.st.st_size <= _budget;
+}
+
+bool ContentCache::holdsInMemory(size_t size) const {
+    return size > 0 && _budget > 0 && size <= _maxEntrySize && size <= _budget;
+}
+
+bool ContentCache::lookup(const FileCache::Entry& file, SharedBuffer& content) {
+    if (!accepts(file)) return false;
+    pthread_mutex_lock(&_mutex);
+    if (_find(_copies, file, content)) {
+        ++_hits;
+        pthread_mutex_unlock(&_mutex);
+        return true;
+    }
+    ++_misses;
+    pthread_mutex_unlock(&_mutex);
+
+    // Read without the lock; a loop missing the same file meanwhile reads
+    // it too, and the last insert replaces the other
+    std::string data;
+    if (!_readFile(file, data)) {
+        Logger::warn("Failed to read " + file.path + " into the content cache");
+        return false;
+    }
+    content = SharedBuffer(data);
+    pthread_mutex_lock(&_mutex);
+    while (!_copies.entries.empty() && _copies.bytes + content.size() > _budget) {
+        _erase(_copies, --_copies.entries.end());
+        ++_evictions;
+    }
+    _insert(_copies, file, content);
+    pthread_mutex_unlock(&_mutex);
+    return true;
+}
+
+void ContentCache::invalidate(const std::string& path) {
+    pthread_mutex_lock(&_mutex);
+    EntryIndex::iterator found = _copies.index.find(path);
+    if (found != _copies.index.end()) _erase(_copies, found->second);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void ContentCache::clear() {
+    pthread_mutex_lock(&_mutex);
+    _copies = Store();
+    pthread_mutex_unlock(&_mutex);
+}
+
+unsigned long ContentCache::getHits() const {
+    return _hits;
+}
+
+unsigned long ContentCache::getMisses() const {
+    return _misses;
+}
+
+unsigned long ContentCache::getEvictions() const {
+    return _evictions;
+}
+
+void ContentCache::logStats() {
+    pthread_mutex_lock(&_mutex);
+    if (_hits != 0 || _misses != 0) {
+        Logger::info("Content cache: " + Utils::intToString((int)_hits) + " hits, " +
+                     Utils::intToString((int)_misses) + " misses, " + Utils::intToString((int)_evictions) +
+                     " evictions, " + Utils::sizeToString(_copies.bytes) + " bytes cached");
+    }
+    pthread_mutex_unlock(&_mutex);
+}
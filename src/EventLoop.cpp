@@ -0,0 +1,199 @@
+#include "EventLoop.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+
+#ifdef WEBSERV_HAVE_EPOLL
+static const int EPOLL_MAX_EVENTS = 1024;
+
+static uint32_t toEpollEvents(short events) {
+    uint32_t ev = 0;
+    if (events & POLLIN) ev |= EPOLLIN;
+    if (events & POLLOUT) ev |= EPOLLOUT;
+    return ev;
+}
+
+static short fromEpollEvents(uint32_t ev) {
+    short revents = 0;
+    if (ev & EPOLLIN) revents |= POLLIN;
+    if (ev & EPOLLOUT) revents |= POLLOUT;
+    if (ev & EPOLLHUP) revents |= POLLHUP;
+    if (ev & EPOLLERR) revents |= POLLERR;
+    return revents;
+}
+#endif
+
+EventLoop::EventLoop() : _watched(0) {
+#ifdef WEBSERV_HAVE_EPOLL
+    _epollFd = -1;
+#endif
+}
+
+EventLoop::~EventLoop() {
+    close();
+}
+
+// The kernel object is created lazily so that a Server can be constructed
+// (and forked) before the loop that actually drives it exists.
+void EventLoop::open() {
+    if (isOpen()) return;
+#ifdef WEBSERV_HAVE_EPOLL
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epollFd < 0) {
+        throw std::runtime_error("epoll_create1() failed: " + std::string(strerror(errno)));
+    }
+    _epollEvents.resize(EPOLL_MAX_EVENTS);
+#endif
+    Logger::debug(std::string("Event loop opened (backend: ") + getBackendName() + ")");
+}
+
+void EventLoop::close() {
+#ifdef WEBSERV_HAVE_EPOLL
+    if (_epollFd != -1) {
+        ::close(_epollFd);
+        _epollFd = -1;
+    }
+    _epollEvents.clear();
+#else
+    _pollFds.clear();
+    _pollIndex.clear();
+#endif
+    _interest.clear();
+    _ready.clear();
+    _watched = 0;
+}
+
+bool EventLoop::isOpen() const {
+#ifdef WEBSERV_HAVE_EPOLL
+    return _epollFd != -1;
+#else
+    return true;
+#endif
+}
+
+bool EventLoop::add(int fd, short events) {
+    if (fd < 0) return false;
+    if (isWatched(fd)) return modify(fd, events);
+    if ((size_t)fd >= _interest.size()) _interest.resize(fd + 1, 0);
+
+#ifdef WEBSERV_HAVE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        // A stale registration for a reused fd number: refresh it instead
+        if (errno != EEXIST || epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            Logger::error("epoll_ctl(ADD) failed for fd=" + Utils::intToString(fd) + ": " + std::string(strerror(errno)));
+            return false;
+        }
+    }
+#else
+    if ((size_t)fd >= _pollIndex.size()) _pollIndex.resize(fd + 1, -1);
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    _pollIndex[fd] = (int)_pollFds.size();
+    _pollFds.push_back(pfd);
+#endif
+    _interest[fd] = events;
+    ++_watched;
+    return true;
+}
+
+bool EventLoop::modify(int fd, short events) {
+    if (!isWatched(fd)) return add(fd, events);
+    if (_interest[fd] == events) return true;
+
+#ifdef WEBSERV_HAVE_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = toEpollEvents(events);
+    ev.data.fd = fd;
+    if (epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        Logger::error("epoll_ctl(MOD) failed for fd=" + Utils::intToString(fd) + ": " + std::string(strerror(errno)));
+        return false;
+    }
+#else
+    _pollFds[_pollIndex[fd]].events = events;
+#endif
+    _interest[fd] = events;
+    return true;
+}
+
+void EventLoop::remove(int fd) {
+    if (!isWatched(fd)) return;
+
+#ifdef WEBSERV_HAVE_EPOLL
+    // The fd may already be closed (e.g. a CGI pipe closed by its owner), in
+    // which case the kernel dropped the registration itself; ignore errors.
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, NULL);
+#else
+    // Swap-remove to keep the pollfd array dense
+    int idx = _pollIndex[fd];
+    int last = (int)_pollFds.size() - 1;
+    if (idx != last) {
+        _pollFds[idx] = _pollFds[last];
+        _pollIndex[_pollFds[idx].fd] = idx;
+    }
+    _pollFds.pop_back();
+    _pollIndex[fd] = -1;
+#endif
+    _interest[fd] = 0;
+    --_watched;
+}
+
+bool EventLoop::isWatched(int fd) const {
+    return fd >= 0 && (size_t)fd < _interest.size() && _interest[fd] != 0;
+}
+
+short EventLoop::getInterest(int fd) const {
+    return isWatched(fd) ? _interest[fd] : 0;
+}
+
+size_t EventLoop::size() const {
+    return _watched;
+}
+
+int EventLoop::wait(int timeoutMs) {
+    _ready.clear();
+
+#ifdef WEBSERV_HAVE_EPOLL
+    int n = epoll_wait(_epollFd, &_epollEvents[0], (int)_epollEvents.size(), timeoutMs);
+    if (n <= 0) return n;
+    for (int i = 0; i < n; ++i) {
+        Event e;
+        e.fd = _epollEvents[i].data.fd;
+        e.revents = fromEpollEvents(_epollEvents[i].events);
+        _ready.push_back(e);
+    }
+#else
+    if (_pollFds.empty()) return 0;
+    int n = poll(&_pollFds[0], _pollFds.size(), timeoutMs);
+    if (n <= 0) return n;
+    for (size_t i = 0; i < _pollFds.size() && (int)_ready.size() < n; ++i) {
+        if (_pollFds[i].revents == 0) continue;
+        Event e;
+        e.fd = _pollFds[i].fd;
+        e.revents = _pollFds[i].revents;
+        _ready.push_back(e);
+    }
+#endif
+    return (int)_ready.size();
+}
+
+size_t EventLoop::getReadyCount() const {
+    return _ready.size();
+}
+
+const EventLoop::Event& EventLoop::getEvent(size_t index) const {
+    return _ready[index];
+}
+
+const char* EventLoop::getBackendName() {
+#ifdef WEBSERV_HAVE_EPOLL
+    return "epoll";
+#else
+    return "poll";
+#endif
+}
@@ -0,0 +1,136 @@
+#include "FileCache.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+
+FileCache::Entry::Entry() : error(0), fd(-1), checkedAt(0) {
+    memset(&st, 0, sizeof(st));
+}
+
+FileCache::FileCache(size_t capacity, long long validMs)
+    : _capacity(capacity), _validMs(validMs), _hits(0), _misses(0), _revalidations(0), _evictions(0) {
+}
+
+FileCache::~FileCache() {
+    clear();
+}
+
+void FileCache::configure(size_t capacity, long long validMs) {
+    clear();
+    _capacity = capacity;
+    _validMs = validMs;
+}
+
+void FileCache::_closeFd(Entry& entry) {
+    if (entry.fd >= 0) close(entry.fd);
+    entry.fd = -1;
+}
+
+void FileCache::_load(Entry& entry, const std::string& path) {
+    _closeFd(entry);
+    entry.path = path;
+    entry.mimeType = Utils::getMimeType(Utils::getFileExtension(path));
+    entry.error = 0;
+    entry.checkedAt = 0;
+    _stat(entry);
+}
+
+// Refresh the metadata; an fd is kept as long as it still names the file
+void FileCache::_stat(Entry& entry) {
+    struct stat st;
+    int error = (stat(entry.path.c_str(), &st) == 0) ? 0 : errno;
+    entry.checkedAt = Utils::nowMs();
+    if (error) {
+        _closeFd(entry);
+        entry.error = error;
+        return;
+    }
+    bool changed = entry.error != 0 || st.st_ino != entry.st.st_ino || st.st_dev != entry.st.st_dev ||
+                   st.st_size != entry.st.st_size || st.st_mtime != entry.st.st_mtime;
+    if (changed) _closeFd(entry);
+    entry.error = 0;
+    entry.st = st;
+}
+
+void FileCache::_open(Entry& entry) {
+    if (entry.error || entry.fd >= 0 || !S_ISREG(entry.st.st_mode)) return;
+    entry.fd = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (entry.fd < 0) {
+        entry.error = errno;
+        return;
+    }
+    // The file may have been replaced since stat(): describe what was opened
+    if (fstat(entry.fd, &entry.st) != 0) {
+        entry.error = errno;
+        _closeFd(entry);
+    }
+}
+
+const FileCache::Entry& FileCache::lookup(const std::string& path, bool wantFd) {
+    if (_capacity == 0) {
+        ++_misses;
+        _load(_scratch, path);
+        if (wantFd) _open(_scratch);
+        return _scratch;
+    }
+
+    EntryIndex::iterator found = _index.find(path);
+    if (found != _index.end()) {
+        EntryList::iterator it = found->second;
+        _entries.splice(_entries.begin(), _entries, it);
+        if (it->error != 0 || Utils::nowMs() - it->checkedAt >= _validMs) {
+            ++_revalidations;
+            _stat(*it);
+        } else {
+            ++_hits;
+        }
+        if (wantFd) _open(*it);
+        return *it;
+    }
+
+    ++_misses;
+    if (_index.size() >= _capacity) {
+        Entry& victim = _entries.back();
+        _closeFd(victim);
+        _index.erase(victim.path);
+        _entries.pop_back();
+        ++_evictions;
+    }
+    _entries.push_front(Entry());
+    _index[path] = _entries.begin();
+    Entry& entry = _entries.front();
+    _load(entry, path);
+    if (wantFd) _open(entry);
+    return entry;
+}
+
+void FileCache::invalidate(const std::string& path) {
+    EntryIndex::iterator found = _index.find(path);
+    if (found == _index.end()) return;
+    _closeFd(*found->second);
+    _entries.erase(found->second);
+    _index.erase(found);
+}
+
+void FileCache::clear() {
+    for (EntryList::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+        _closeFd(*it);
+    }
+    _entries.clear();
+    _index.clear();
+    _closeFd(_scratch);
+}
+
+unsigned long FileCache::getHits() const {
+    return _hits;
+}
+
+unsigned long FileCache::getMisses() const {
+    return _misses;
+}
+
+void FileCache::logStats() const {
+    if (_hits == 0 && _misses == 0) return;
+    Logger::info("Open file cache: " + Utils::intToString((int)_hits) + " hits, " + Utils::intToString((int)_misses) +
+                 " misses, " + Utils::intToString((int)_revalidations) + " revalidations, " +
+                 Utils::intToString((int)_evictions) + " evictions");
+}
@@ -0,0 +1,99 @@
+#include "HandoffQueue.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
+
+HandoffQueue::HandoffQueue(size_t capacity) : _head(0), _tail(0), _wakeReadFd(-1), _wakeWriteFd(-1) {
+    // Round up to a power of two so indices wrap with a mask
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    Slot empty = {-1, -1};
+    _slots.resize(size, empty);
+    _mask = size - 1;
+
+#ifdef __linux__
+    _wakeReadFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeReadFd < 0) {
+        throw std::runtime_error("eventfd() failed: " + std::string(strerror(errno)));
+    }
+    _wakeWriteFd = _wakeReadFd;
+#else
+    int fds[2];
+    if (pipe(fds) < 0) {
+        throw std::runtime_error("pipe() failed: " + std::string(strerror(errno)));
+    }
+    for (int i = 0; i < 2; ++i) {
+        Utils::setNonBlocking(fds[i]);
+        Utils::setCloseOnExec(fds[i]);
+    }
+    _wakeReadFd = fds[0];
+    _wakeWriteFd = fds[1];
+#endif
+}
+
+HandoffQueue::~HandoffQueue() {
+    // Connections that were handed off but never adopted are closed here
+    int fd;
+    int listener;
+    while (pop(fd, listener)) close(fd);
+    if (_wakeWriteFd != -1 && _wakeWriteFd != _wakeReadFd) close(_wakeWriteFd);
+    if (_wakeReadFd != -1) close(_wakeReadFd);
+}
+
+bool HandoffQueue::push(int fd, int listener) {
+    size_t tail = _tail;
+    if (tail - _head > _mask) return false; // full
+    _slots[tail & _mask].fd = fd;
+    _slots[tail & _mask].listener = listener;
+    // Publish the slot before the new tail becomes visible to the consumer
+    __sync_synchronize();
+    _tail = tail + 1;
+    return true;
+}
+
+bool HandoffQueue::pop(int& fd, int& listener) {
+    size_t head = _head;
+    if (head == _tail) return false; // empty
+    __sync_synchronize();
+    fd = _slots[head & _mask].fd;
+    listener = _slots[head & _mask].listener;
+    // Finish reading the slot before the producer may reuse it
+    __sync_synchronize();
+    _head = head + 1;
+    return true;
+}
+
+void HandoffQueue::notify() {
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(_wakeWriteFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        Logger::error("HandoffQueue: eventfd write failed: " + std::string(strerror(errno)));
+    }
+#else
+    char byte = 1;
+    // A full pipe already guarantees a pending wakeup
+    if (write(_wakeWriteFd, &byte, 1) < 0 && errno != EAGAIN) {
+        Logger::error("HandoffQueue: wakeup pipe write failed: " + std::string(strerror(errno)));
+    }
+#endif
+}
+
+void HandoffQueue::drainWakeups() {
+#ifdef __linux__
+    uint64_t count;
+    while (read(_wakeReadFd, &count, sizeof(count)) > 0) {}
+#else
+    char buf[256];
+    while (read(_wakeReadFd, buf, sizeof(buf)) > 0) {}
+#endif
+}
+
+int HandoffQueue::getWakeFd() const {
+    return _wakeReadFd;
+}
+
+size_t HandoffQueue::size() const {
+    return _tail - _head;
+}
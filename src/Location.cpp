@@ -3,13 +3,13 @@
 #include "Logger.hpp"
 
 Location::Location() : _path("/"), _root("./www"), _index("index.html"), 
-                       _autoindex(false), _maxBodySize(MAX_BODY_SIZE) {
+                       _autoindex(false), _maxBodySize(MAX_BODY_SIZE), _gzipStatic(false) {
     _allowedMethods.push_back("GET");
 }
 
 Location::Location(const std::string& path) : _path(path), _root("./www"), 
                                               _index("index.html"), _autoindex(false), 
-                                              _maxBodySize(MAX_BODY_SIZE) {
+                                              _maxBodySize(MAX_BODY_SIZE), _gzipStatic(false) {
     _allowedMethods.push_back("GET");
 }
 
@@ -29,6 +29,9 @@ Location& Location::operator=(const Location& other) {
         _cgiPath = other._cgiPath;
         _cgiExtension = other._cgiExtension;
         _maxBodySize = other._maxBodySize;
+        _gzipStatic = other._gzipStatic;
+        _compression = other._compression;
+        _responseHeaders = other._responseHeaders;
     }
     return *this;
 }
@@ -47,6 +50,9 @@ const std::string& Location::getUploadPath() const { return _uploadPath; }
 const std::string& Location::getCgiPath() const { return _cgiPath; }
 const std::string& Location::getCgiExtension() const { return _cgiExtension; }
 size_t Location::getMaxBodySize() const { return _maxBodySize; }
+bool Location::getGzipStatic() const { return _gzipStatic; }
+const Compression::Settings& Location::getCompression() const { return _compression; }
+const Location::HeaderList& Location::getResponseHeaders() const { return _responseHeaders; }
 
 // Setters
 void Location::setPath(const std::string& path) { _path = path; }
@@ -72,6 +78,37 @@ void Location::setUploadPath(const std::string& uploadPath) { _uploadPath = uplo
 void Location::setCgiPath(const std::string& cgiPath) { _cgiPath = cgiPath; }
 void Location::setCgiExtension(const std::string& cgiExtension) { _cgiExtension = cgiExtension; }
 void Location::setMaxBodySize(size_t maxBodySize) { _maxBodySize = maxBodySize; }
+void Location::setGzipStatic(bool gzipStatic) { _gzipStatic = gzipStatic; }
+void Location::setCompressionLevel(int level) { _compression.level = level; }
+void Location::setCompressionMinLength(size_t minLength) { _compression.minLength = minLength; }
+
+void Location::setCompressionTypes(const std::vector<std::string>& types) {
+    _compression.types.clear();
+    for (size_t i = 0; i < types.size(); ++i) {
+        _compression.types.push_back(Utils::toLowerCase(types[i]));
+    }
+}
+
+void Location::setResponseHeader(const std::string& name, const std::string& value) {
+    std::string lowerName = Utils::toLowerCase(name);
+    for (HeaderList::iterator it = _responseHeaders.begin(); it != _responseHeaders.end(); ++it) {
+        if (Utils::toLowerCase(it->first) == lowerName) {
+            it->second = value;
+            return;
+        }
+    }
+    _responseHeaders.push_back(std::make_pair(name, value));
+}
+
+void Location::removeResponseHeader(const std::string& name) {
+    std::string lowerName = Utils::toLowerCase(name);
+    for (HeaderList::iterator it = _responseHeaders.begin(); it != _responseHeaders.end(); ++it) {
+        if (Utils::toLowerCase(it->first) == lowerName) {
+            _responseHeaders.erase(it);
+            return;
+        }
+    }
+}
 
 bool Location::isMethodAllowed(const std::string& method) const {
     std::string upperMethod = Utils::toUpperCase(method);
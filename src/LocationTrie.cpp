@@ -0,0 +1,101 @@
+#include "LocationTrie.hpp"
+
+const int LocationTrie::NONE;
+
+LocationTrie::LocationTrie() : _catchAll(NONE) {
+}
+
+// Insert the paths into a map-based trie, then lay it out breadth-first so
+// every node's edges are contiguous and sorted by byte
+void LocationTrie::build(const std::vector<Location>& locations) {
+    std::vector<std::map<unsigned char, size_t> > children(1);
+    std::vector<int> ends(1, NONE);
+    _catchAll = NONE;
+
+    for (size_t i = 0; i < locations.size(); ++i) {
+        const std::string& path = locations[i].getPath();
+        if (path.empty()) continue;
+        if (path == "/") {
+            if (_catchAll == NONE) _catchAll = (int)i;
+            continue;
+        }
+        size_t node = 0;
+        for (size_t j = 0; j < path.size(); ++j) {
+            unsigned char byte = (unsigned char)path[j];
+            std::map<unsigned char, size_t>::iterator it = children[node].find(byte);
+            if (it == children[node].end()) {
+                children[node][byte] = children.size();
+                node = children.size();
+                children.push_back(std::map<unsigned char, size_t>());
+                ends.push_back(NONE);
+            } else {
+                node = it->second;
+            }
+        }
+        if (ends[node] == NONE) ends[node] = (int)i;
+    }
+
+    std::vector<size_t> order(1, 0);   // old node ids, breadth-first
+    std::vector<size_t> position(children.size(), 0);
+    for (size_t k = 0; k < order.size(); ++k) {
+        std::map<unsigned char, size_t>& edges = children[order[k]];
+        for (std::map<unsigned char, size_t>::iterator it = edges.begin(); it != edges.end(); ++it) {
+            position[it->second] = order.size();
+            order.push_back(it->second);
+        }
+    }
+
+    _nodes.clear();
+    _edges.clear();
+    _nodes.reserve(order.size());
+    _edges.reserve(order.size() - 1);
+    for (size_t k = 0; k < order.size(); ++k) {
+        const std::map<unsigned char, size_t>& edges = children[order[k]];
+        Node node;
+        node.firstEdge = _edges.size();
+        node.edgeCount = edges.size();
+        node.location = ends[order[k]];
+        _nodes.push_back(node);
+        for (std::map<unsigned char, size_t>::const_iterator it = edges.begin(); it != edges.end(); ++it) {
+            Edge edge;
+            edge.byte = it->first;
+            edge.child = position[it->second];
+            _edges.push_back(edge);
+        }
+    }
+}
+
+int LocationTrie::match(const std::string& uri) const {
+    int best = _catchAll;
+    if (_nodes.empty()) return best;
+
+    const char* data = uri.data();
+    size_t length = uri.size();
+    size_t node = 0;
+    for (size_t depth = 0;; ++depth) {
+        // The node spells uri[0, depth); a path ending here must end on a
+        // segment boundary, unless it ends with '/' itself
+        const Node& current = _nodes[node];
+        if (current.location != NONE &&
+            (depth == length || data[depth - 1] == '/' || data[depth] == '/')) {
+            best = current.location;
+        }
+        if (depth == length) break;
+
+        unsigned char byte = (unsigned char)data[depth];
+        size_t low = current.firstEdge;
+        size_t high = current.firstEdge + current.edgeCount;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (_edges[middle].byte < byte) low = middle + 1;
+            else high = middle;
+        }
+        if (low == current.firstEdge + current.edgeCount || _edges[low].byte != byte) break;
+        node = _edges[low].child;
+    }
+    return best;
+}
+
+size_t LocationTrie::size() const {
+    return _nodes.size();
+}
@@ -1,14 +1,20 @@
 #include "Logger.hpp"
+#include <pthread.h>
 
 Logger::LogLevel Logger::_level = INFO;
 
+// Serializes formatting and output when several event-loop threads log
+static pthread_mutex_t g_logMutex = PTHREAD_MUTEX_INITIALIZER;
+
 void Logger::setLevel(LogLevel level) {
     _level = level;
 }
 
 std::string Logger::_getTimestamp() {
     time_t now = time(0);
-    char* timeStr = ctime(&now);
+    char timeStr[32];
+    // Reentrant form of ctime(): same layout, no shared static buffer
+    ctime_r(&now, timeStr);
     std::string timestamp(timeStr);
     if (!timestamp.empty() && timestamp[timestamp.length() - 1] == '\n') {
         timestamp.erase(timestamp.length() - 1);
@@ -28,9 +34,12 @@ std::string Logger::_getLevelString(LogLevel level) {
 
 void Logger::log(LogLevel level, const std::string& message) {
     if (level >= _level) {
-        std::cerr << "[" << _getTimestamp() << "] " 
+        std::string timestamp = _getTimestamp();
+        pthread_mutex_lock(&g_logMutex);
+        std::cerr << "[" << timestamp << "] " 
                   << _getLevelString(level) << ": " 
                   << message << std::endl;
+        pthread_mutex_unlock(&g_logMutex);
     }
 }
 
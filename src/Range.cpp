@@ -18,6 +18,7 @@ Range& Range::operator=(const Range& other) {
     if (this != &other) {
         _ranges = other._ranges;
         _contentLength = other._contentLength;
+        _boundary = other._boundary;
     }
     return *this;
 }
@@ -28,6 +29,7 @@ Range::~Range() {
 bool Range::parseRangeHeader(const std::string& rangeHeader, size_t contentLength) {
     _contentLength = contentLength;
     _ranges.clear();
+    _boundary.clear();
     
     if (rangeHeader.empty() || contentLength == 0) return false;
     
@@ -80,6 +82,7 @@ bool Range::parseRangeHeader(const std::string& rangeHeader, size_t contentLengt
         }
     }
     
+    if (_ranges.size() > 1) _boundary = generateBoundary();
     return !_ranges.empty();
 }
 
@@ -121,36 +124,51 @@ std::string Range::extractRange(const std::string& content, const ByteRange& ran
 std::string Range::generateMultipartBody(const std::string& content, const std::string& contentType) const {
     if (_ranges.size() <= 1) return "";
     
-    std::string boundary = generateBoundary();
     std::string body;
     
     for (size_t i = 0; i < _ranges.size(); ++i) {
         const ByteRange& range = _ranges[i];
         if (!range.isValid) continue;
         
-        body += "\r\n--" + boundary + "\r\n";
-        body += "Content-Type: " + contentType + "\r\n";
-        body += "Content-Range: bytes " + Utils::intToString(range.start) + "-" 
-                + Utils::intToString(range.end) + "/" + Utils::intToString(_contentLength) + "\r\n";
-        body += "\r\n";
+        body += generatePartHeader(range, contentType);
         body += extractRange(content, range);
     }
     
-    body += "\r\n--" + boundary + "--\r\n";
+    body += generateMultipartTrailer();
     return body;
 }
 
+std::string Range::generatePartHeader(const ByteRange& range, const std::string& contentType) const {
+    std::string header = "\r\n--" + _boundary + "\r\n";
+    if (!contentType.empty()) header += "Content-Type: " + contentType + "\r\n";
+    header += "Content-Range: " + generateContentRangeHeader(range) + "\r\n";
+    header += "\r\n";
+    return header;
+}
+
+std::string Range::generateMultipartTrailer() const {
+    return "\r\n--" + _boundary + "--\r\n";
+}
+
+std::string Range::getMultipartContentType() const {
+    return "multipart/byteranges; boundary=" + _boundary;
+}
+
 std::string Range::generateContentRangeHeader(const ByteRange& range) const {
     if (!range.isValid) return "";
     
-    return "bytes " + Utils::intToString(range.start) + "-" 
-           + Utils::intToString(range.end) + "/" + Utils::intToString(_contentLength);
+    return "bytes " + Utils::sizeToString(range.start) + "-" 
+           + Utils::sizeToString(range.end) + "/" + Utils::sizeToString(_contentLength);
+}
+
+std::string Range::generateUnsatisfiedRangeHeader() const {
+    return "bytes */" + Utils::sizeToString(_contentLength);
 }
 
 std::string Range::generateContentLengthHeader(const ByteRange& range) const {
     if (!range.isValid) return "0";
     
-    return Utils::intToString(range.end - range.start + 1);
+    return Utils::sizeToString(range.end - range.start + 1);
 }
 
 bool Range::isRangeRequest(const std::string& rangeHeader) {
@@ -108,7 +108,7 @@ Request::ParseState Request::parse(const std::string& data) {
             } else if (hasHeader("transfer-encoding") && 
                        Utils::toLowerCase(getHeader("transfer-encoding")) == "chunked") {
                 _isChunked = true;
-                _chunkStartTime = time(NULL);  // Start timing chunked uploads
+                _chunkStartTime = Utils::now();  // Start timing chunked uploads
                 _state = PARSE_BODY;
             } else {
                 _state = PARSE_COMPLETE;
@@ -126,7 +126,7 @@ Request::ParseState Request::parse(const std::string& data) {
         // and reset the inactivity timer to avoid false timeouts during
         // long, legitimate uploads.
         if (_isChunked) {
-            _chunkStartTime = time(NULL);
+            _chunkStartTime = Utils::now();
         }
         if (_isChunked) {
             _parseChunkedBody(buffer);
@@ -254,7 +254,7 @@ void Request::_parseChunkedBody(const std::string& data) {
             _expectedChunkSize = Utils::hexToSize(chunkSizeStr);
             Logger::debug("Chunked parser: found chunk size header '" + chunkSizeStr + "' -> " + Utils::intToString(_expectedChunkSize));
             // Activity observed: reset timer when we successfully parse a chunk size
-            _chunkStartTime = time(NULL);
+            _chunkStartTime = Utils::now();
             buffer = buffer.substr(pos + 2);
 
             if (_expectedChunkSize == 0) {
@@ -269,7 +269,7 @@ void Request::_parseChunkedBody(const std::string& data) {
                 _body += buffer.substr(0, _expectedChunkSize);
                 Logger::debug("Chunked parser: consumed chunk of size " + Utils::intToString(_expectedChunkSize));
                 // Activity observed: reset timer when we consume a full chunk
-                _chunkStartTime = time(NULL);
+                _chunkStartTime = Utils::now();
                 buffer = buffer.substr(_expectedChunkSize + 2); // +2 for \r\n
                 _readingChunkSize = true;
             } else {
@@ -411,13 +411,21 @@ std::map<std::string, std::string> Request::getQueryParams() const {
     return params;
 }
 
+time_t Request::getChunkStartTime() const {
+    return _chunkStartTime;
+}
+
+bool Request::hasPendingHeaders() const {
+    return !_rawRequest.empty() && (_state == PARSE_REQUEST_LINE || _state == PARSE_HEADERS);
+}
+
 bool Request::hasChunkedTimeout(int timeoutSeconds) const {
     if (!_isChunked || _chunkStartTime == 0) {
         return false;  // Not a chunked request or timing not started
     }
     
     // Check if chunked upload has been going on for too long without completion
-    time_t now = time(NULL);
+    time_t now = Utils::now();
     time_t elapsed = now - _chunkStartTime;
     
     if (elapsed > timeoutSeconds) {
@@ -3,16 +3,18 @@
 #include "Logger.hpp"
 #include <sstream> // add
 
-Response::Response() : _statusCode(200), _statusMessage("OK"), _isComplete(false), _bytesSent(0) {
+Response::Response() : _statusCode(200), _statusMessage("OK"), _isComplete(false), _bytesSent(0),
+                       _sharedOffset(0), _sharedLength(0), _file(NULL), _fileOffset(0), _fileLength(0) {
     addDefaultHeaders();
 }
 
-Response::Response(int statusCode) : _statusCode(statusCode), _isComplete(false), _bytesSent(0) {
+Response::Response(int statusCode) : _statusCode(statusCode), _isComplete(false), _bytesSent(0),
+                                     _sharedOffset(0), _sharedLength(0), _file(NULL), _fileOffset(0), _fileLength(0) {
     _statusMessage = Utils::getStatusMessage(statusCode);
     addDefaultHeaders();
 }
 
-Response::Response(const Response& other) {
+Response::Response(const Response& other) : _sharedOffset(0), _sharedLength(0), _file(NULL), _fileOffset(0), _fileLength(0) {
     *this = other;
 }
 
@@ -22,13 +24,37 @@ Response& Response::operator=(const Response& other) {
         _statusMessage = other._statusMessage;
         _headers = other._headers;
         _body = other._body;
+        _sharedBody = other._sharedBody;
+        _sharedOffset = other._sharedOffset;
+        _sharedLength = other._sharedLength;
         _isComplete = other._isComplete;
         _bytesSent = other._bytesSent;
+        _releaseFile();
+        _file = other._file;
+        if (_file) ++_file->refs;
+        _fileOffset = other._fileOffset;
+        _fileLength = other._fileLength;
+        _parts = other._parts;
+        _partsTrailer = other._partsTrailer;
     }
     return *this;
 }
 
 Response::~Response() {
+    _releaseFile();
+}
+
+// Also drops the multipart layout, which only described the old body
+void Response::_releaseFile() {
+    if (_file && --_file->refs == 0) {
+        close(_file->fd);
+        delete _file;
+    }
+    _file = NULL;
+    _fileOffset = 0;
+    _fileLength = 0;
+    _parts.clear();
+    _partsTrailer.clear();
 }
 
 void Response::setStatusCode(int statusCode) {
@@ -40,17 +66,61 @@ void Response::setHeader(const std::string& name, const std::string& value) {
     _headers[name] = value;
 }
 
+// Drops every capitalization of `name` (CGI scripts spell headers freely)
+void Response::removeHeader(const std::string& name) {
+    _headers.erase(name);
+    std::string target = Utils::toLowerCase(name);
+    for (Headers::iterator it = _headers.begin(); it != _headers.end();) {
+        if (Utils::toLowerCase(it->first) == target) _headers.erase(it++);
+        else ++it;
+    }
+}
+
+void Response::releaseBody(std::string& out) {
+    out.clear();
+    if (!_sharedBody.isNull()) {
+        out.assign(_sharedBody.data() + _sharedOffset, _sharedLength);
+        _sharedBody.reset();
+        return;
+    }
+    out.swap(_body);
+}
+
+void Response::setSharedBody(const SharedBuffer& body) {
+    _releaseFile();
+    _body.clear();
+    _sharedBody = body;
+    setSharedRange(0, body.size());
+}
+
+void Response::setSharedRange(size_t offset, size_t length) {
+    if (_sharedBody.isNull()) return;
+    _sharedOffset = offset;
+    _sharedLength = length;
+    setHeader("Content-Length", Utils::sizeToString(length));
+}
+
 void Response::setBody(const std::string& body) {
+    _releaseFile();
+    _sharedBody.reset();
     _body = body;
     setHeader("Content-Length", Utils::intToString(_body.length()));
 }
 
 void Response::setBody(const char* data, size_t length) {
+    _releaseFile();
+    _sharedBody.reset();
     _body.assign(data, length);
     setHeader("Content-Length", Utils::intToString(_body.length()));
 }
 
 void Response::appendBody(const std::string& data) {
+    _parts.clear();
+    _partsTrailer.clear();
+    if (!_sharedBody.isNull()) {
+        _body.assign(_sharedBody.data() + _sharedOffset, _sharedLength);
+        _sharedBody.reset();
+    }
     _body += data;
     setHeader("Content-Length", Utils::intToString(_body.length()));
 }
@@ -59,6 +129,50 @@ void Response::setComplete(bool complete) {
     _isComplete = complete;
 }
 
+void Response::setFileBody(int fd, off_t offset, size_t length) {
+    _releaseFile();
+    _body.clear();
+    _sharedBody.reset();
+    _file = new FileBody();
+    _file->fd = fd;
+    _file->refs = 1;
+    setFileRange(offset, length);
+}
+
+void Response::setFileRange(off_t offset, size_t length) {
+    if (!_file) return;
+    _fileOffset = offset;
+    _fileLength = length;
+    setHeader("Content-Length", Utils::sizeToString(length));
+}
+
+void Response::setBodyParts(const std::vector<BodyPart>& parts, const std::string& trailer) {
+    if (!_file && _sharedBody.isNull()) return;
+    _parts = parts;
+    _partsTrailer = trailer;
+    size_t length = trailer.size();
+    for (size_t i = 0; i < parts.size(); ++i) {
+        length += parts[i].header.size() + parts[i].length;
+    }
+    setHeader("Content-Length", Utils::sizeToString(length));
+}
+
+int Response::detachFile(off_t& offset, size_t& length) {
+    if (!_file) return -1;
+    int fd = _file->fd;
+    if (--_file->refs > 0) {
+        fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    } else {
+        delete _file;
+    }
+    offset = _fileOffset;
+    length = _fileLength;
+    _file = NULL;
+    _fileOffset = 0;
+    _fileLength = 0;
+    return fd;
+}
+
 // Cookie support (BONUS)
 void Response::setCookie(const Cookie& cookie) {
     if (cookie.isValid()) {
@@ -75,9 +189,39 @@ int Response::getStatusCode() const { return _statusCode; }
 const std::string& Response::getStatusMessage() const { return _statusMessage; }
 const Headers& Response::getHeaders() const { return _headers; }
 const std::string& Response::getBody() const { return _body; }
+
+const char* Response::getBodyData(size_t& length) const {
+    if (_file || !_parts.empty()) {
+        length = 0;
+        return NULL;
+    }
+    if (!_sharedBody.isNull()) {
+        length = _sharedLength;
+        return _sharedBody.data() + _sharedOffset;
+    }
+    length = _body.size();
+    return _body.data();
+}
+
 bool Response::isComplete() const { return _isComplete; }
 size_t Response::getBytesSent() const { return _bytesSent; }
-size_t Response::getContentLength() const { return _body.length(); }
+size_t Response::getContentLength() const {
+    if (!_parts.empty()) {
+        size_t length = _partsTrailer.size();
+        for (size_t i = 0; i < _parts.size(); ++i) length += _parts[i].header.size() + _parts[i].length;
+        return length;
+    }
+    if (_file) return _fileLength;
+    return _sharedBody.isNull() ? _body.length() : _sharedLength;
+}
+bool Response::hasSharedBody() const { return !_sharedBody.isNull(); }
+const SharedBuffer& Response::getSharedBody() const { return _sharedBody; }
+size_t Response::getSharedOffset() const { return _sharedOffset; }
+bool Response::hasFileBody() const { return _file != NULL; }
+off_t Response::getFileOffset() const { return _fileOffset; }
+size_t Response::getFileLength() const { return _fileLength; }
+const std::vector<Response::BodyPart>& Response::getBodyParts() const { return _parts; }
+const std::string& Response::getBodyPartsTrailer() const { return _partsTrailer; }
 
 std::string Response::getHeader(const std::string& name) const {
     Headers::const_iterator it = _headers.find(name);
@@ -141,7 +285,11 @@ std::string Response::toString(bool withBody) const {
     }
 
     ss << "\r\n";
-    if (withBody) ss << _body;
+    if (withBody) {
+        size_t length;
+        const char* body = getBodyData(length);
+        if (body) ss.write(body, length);
+    }
     return ss.str();
 }
 
@@ -150,6 +298,8 @@ void Response::reset() {
     _statusMessage = "OK";
     _headers.clear();
     _body.clear();
+    _sharedBody.reset();
+    _releaseFile();
     _isComplete = false;
     _bytesSent = 0;
     addDefaultHeaders();
@@ -217,15 +367,17 @@ Response Response::createRedirectResponse(int statusCode, const std::string& loc
 }
 
 Response Response::createFileResponse(const std::string& filename, const std::string& mimeType) {
-    Response response;
-    
-    if (!Utils::fileExists(filename)) {
-        return createErrorResponse(HTTP_NOT_FOUND);
+    // The body stays in the file: it is sent with sendfile() once queued
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT || errno == ENOTDIR) return createErrorResponse(HTTP_NOT_FOUND);
+        Logger::error("Failed to open file: " + filename + ": " + strerror(errno));
+        return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
     }
-    
-    std::string content = Utils::readFile(filename);
-    if (content.empty()) {
-        Logger::error("Failed to read file: " + filename);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        Logger::error("Not a regular file: " + filename);
+        close(fd);
         return createErrorResponse(HTTP_INTERNAL_SERVER_ERROR);
     }
     
@@ -234,13 +386,31 @@ Response Response::createFileResponse(const std::string& filename, const std::st
         contentType = Utils::getMimeType(Utils::getFileExtension(filename));
     }
     
-    response.setHeader("Content-Type", contentType);
-    response.setBody(content);
+    Response response = createFileMetadataResponse(st, contentType);
+    response.setFileBody(fd, 0, (size_t)st.st_size);
+    return response;
+}
+
+Response Response::createFileMetadataResponse(const struct stat& st, const std::string& mimeType) {
+    Response response;
+    response.setHeader("Content-Type", mimeType);
+    response.setHeader("Content-Length", Utils::sizeToString((size_t)st.st_size));
+    response.setHeader("ETag", makeETag(st));
+    response.setHeader("Last-Modified", Utils::formatHttpDate(st.st_mtime));
+    response.setHeader("Accept-Ranges", "bytes");
     response.setComplete(true);
-    
     return response;
 }
 
+// Weak: the mtime has a one-second resolution, so two writes within the same
+// second may share a tag
+std::string Response::makeETag(const struct stat& st) {
+    std::ostringstream tag;
+    tag << "W/\"" << std::hex << (unsigned long)st.st_ino << "-" << (unsigned long long)st.st_size << "-"
+        << (unsigned long long)st.st_mtime << "\"";
+    return tag.str();
+}
+
 Response Response::createDirectoryListingResponse(const std::string& path, const std::string& uri) {
     Response response;
     
@@ -0,0 +1,234 @@
+#include "SendBuffer.hpp"
+
+SendBuffer::SendBuffer() : _size(0) {
+}
+
+SendBuffer::SendBuffer(const SendBuffer& other) : _size(0) {
+    *this = other;
+}
+
+SendBuffer& SendBuffer::operator=(const SendBuffer& other) {
+    if (this != &other) {
+        clear();
+        for (std::deque<Chunk>::const_iterator it = other._chunks.begin(); it != other._chunks.end(); ++it) {
+            if (it->fileFd >= 0) {
+                int fd = fcntl(it->fileFd, F_DUPFD_CLOEXEC, 0);
+                if (fd >= 0) appendFile(fd, it->fileOffset, it->fileRemaining);
+                continue;
+            }
+            if (!it->shared.isNull()) {
+                appendShared(it->shared, it->offset, it->end - it->offset);
+                continue;
+            }
+            append(it->data.data() + it->offset, it->data.size() - it->offset);
+        }
+    }
+    return *this;
+}
+
+SendBuffer::~SendBuffer() {
+    clear();
+}
+
+bool SendBuffer::empty() const {
+    return _size == 0;
+}
+
+size_t SendBuffer::size() const {
+    return _size;
+}
+
+SendBuffer::Chunk& SendBuffer::_pushChunk() {
+    _chunks.push_back(Chunk());
+    Chunk& chunk = _chunks.back();
+    if (!_spare.empty()) {
+        chunk.data.swap(_spare.back());
+        _spare.pop_back();
+    }
+    return chunk;
+}
+
+void SendBuffer::_popChunk() {
+    Chunk& chunk = _chunks.front();
+    if (chunk.fileFd >= 0) close(chunk.fileFd);
+    chunk.shared.reset();
+    // Only coalescing chunks are worth keeping; adopted large strings are freed
+    if (_spare.size() < MAX_SPARE_CHUNKS && chunk.data.capacity() > 0 && chunk.data.capacity() <= 2 * CHUNK_SIZE) {
+        chunk.data.clear();
+        _spare.push_back(std::string());
+        _spare.back().swap(chunk.data);
+    }
+    _chunks.pop_front();
+}
+
+void SendBuffer::append(const char* data, size_t length) {
+    if (length == 0) return;
+    // Coalesce small writes into the tail chunk
+    if (_chunks.empty() || !_chunks.back().isOwnedMemory() || _chunks.back().data.size() + length > CHUNK_SIZE) {
+        _pushChunk();
+    }
+    _chunks.back().data.append(data, length);
+    _size += length;
+}
+
+void SendBuffer::append(const std::string& data) {
+    append(data.data(), data.size());
+}
+
+void SendBuffer::appendOwned(std::string& data) {
+    if (data.empty()) return;
+    if (data.size() < CHUNK_SIZE) {
+        append(data);
+        data.clear();
+        return;
+    }
+    _chunks.push_back(Chunk());
+    _chunks.back().data.swap(data);
+    _size += _chunks.back().data.size();
+}
+
+void SendBuffer::prepend(const std::string& data) {
+    if (data.empty()) return;
+    _chunks.push_front(Chunk());
+    _chunks.front().data = data;
+    _size += data.size();
+}
+
+void SendBuffer::appendShared(const SharedBuffer& data, size_t offset, size_t length) {
+    if (offset >= data.size()) return;
+    length = std::min(length, data.size() - offset);
+    if (length == 0) return;
+    _chunks.push_back(Chunk());
+    Chunk& chunk = _chunks.back();
+    chunk.shared = data;
+    chunk.offset = offset;
+    chunk.end = offset + length;
+    _size += length;
+}
+
+void SendBuffer::appendFile(int fd, off_t offset, size_t length) {
+    if (length == 0) {
+        close(fd);
+        return;
+    }
+    _chunks.push_back(Chunk());
+    Chunk& chunk = _chunks.back();
+    chunk.fileFd = fd;
+    chunk.fileOffset = offset;
+    chunk.fileRemaining = length;
+    _size += length;
+}
+
+const char* SendBuffer::frontData() const {
+    if (_chunks.empty()) return NULL;
+    return _chunks.front().bytes() + _chunks.front().offset;
+}
+
+size_t SendBuffer::frontSize() const {
+    if (_chunks.empty() || _chunks.front().fileFd >= 0) return 0;
+    return _chunks.front().available();
+}
+
+size_t SendBuffer::fillIovec(struct iovec* iov, size_t maxCount, bool* fileFollows) const {
+    size_t count = 0;
+    std::deque<Chunk>::const_iterator it = _chunks.begin();
+    for (; it != _chunks.end() && count < maxCount && it->fileFd < 0; ++it) {
+        iov[count].iov_base = const_cast<char*>(it->bytes() + it->offset);
+        iov[count].iov_len = it->available();
+        ++count;
+    }
+    if (fileFollows) *fileFollows = (it != _chunks.end() && it->fileFd >= 0);
+    return count;
+}
+
+bool SendBuffer::frontFile(int& fd, off_t& offset, size_t& length) const {
+    if (_chunks.empty() || _chunks.front().fileFd < 0) return false;
+    const Chunk& chunk = _chunks.front();
+    fd = chunk.fileFd;
+    offset = chunk.fileOffset;
+    length = chunk.fileRemaining;
+    return true;
+}
+
+void SendBuffer::consume(size_t length) {
+    if (length > _size) length = _size;
+    _size -= length;
+    while (length > 0) {
+        Chunk& chunk = _chunks.front();
+        size_t available = chunk.available();
+        if (length < available) {
+            if (chunk.fileFd >= 0) {
+                chunk.fileOffset += length;
+                chunk.fileRemaining -= length;
+            } else {
+                chunk.offset += length;
+            }
+            return;
+        }
+        length -= available;
+        _popChunk();
+    }
+    // Skip chunks that were emptied exactly at a boundary
+    while (!_chunks.empty() && _chunks.front().available() == 0) {
+        _popChunk();
+    }
+}
+
+bool SendBuffer::startsWith(const std::string& prefix) const {
+    if (prefix.size() > _size) return false;
+    size_t matched = 0;
+    for (std::deque<Chunk>::const_iterator it = _chunks.begin();
+         it != _chunks.end() && it->fileFd < 0 && matched < prefix.size(); ++it) {
+        size_t n = std::min(it->available(), prefix.size() - matched);
+        if (memcmp(it->bytes() + it->offset, prefix.data() + matched, n) != 0) return false;
+        matched += n;
+    }
+    return matched == prefix.size();
+}
+
+// Searches across chunk boundaries by carrying the tail of each chunk over
+bool SendBuffer::contains(const std::string& needle) const {
+    if (needle.empty()) return true;
+    std::string carry;
+    for (std::deque<Chunk>::const_iterator it = _chunks.begin(); it != _chunks.end() && it->fileFd < 0; ++it) {
+        const char* begin = it->bytes() + it->offset;
+        const char* end = begin + it->available();
+        if (!carry.empty()) {
+            std::string window = carry + std::string(begin, std::min(it->available(), needle.size() - 1));
+            if (window.find(needle) != std::string::npos) return true;
+        }
+        if (std::search(begin, end, needle.begin(), needle.end()) != end) return true;
+        size_t keep = std::min(it->available(), needle.size() - 1);
+        carry.assign(end - keep, end);
+    }
+    return false;
+}
+
+std::string SendBuffer::str() const {
+    std::string out;
+    for (std::deque<Chunk>::const_iterator it = _chunks.begin(); it != _chunks.end() && it->fileFd < 0; ++it) {
+        out.append(it->bytes() + it->offset, it->available());
+    }
+    return out;
+}
+
+void SendBuffer::clear() {
+    while (!_chunks.empty()) {
+        _popChunk();
+    }
+    _size = 0;
+}
+
+void SendBuffer::trim(size_t maxCapacity) {
+    clear();
+    size_t kept = 0;
+    for (size_t i = 0; i < _spare.size(); ) {
+        if (kept + _spare[i].capacity() > maxCapacity) {
+            _spare[i].swap(_spare.back());
+            _spare.pop_back();
+            continue;
+        }
+        kept += _spare[i].capacity();
+        ++i;
+    }
+}
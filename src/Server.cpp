@@ -3,24 +3,68 @@
 #include "Logger.hpp"
 #include <fcntl.h>
 #include <netinet/tcp.h>
+#include <iomanip>
+#ifdef __linux__
+# include <sys/prctl.h>
+#endif
+
+// A worker that dies this soon after being spawned is treated as a startup
+// failure (e.g. a port that cannot be bound) rather than a crash to recover.
+static const time_t WORKER_STARTUP_GRACE_SECONDS = 2;
+
+// Connections queued for a loop thread but not yet adopted by it
+static const size_t HANDOFF_QUEUE_CAPACITY = 4096;
+
+// Client timeouts, all driven by the timer wheel
+static const int IDLE_TIMEOUT_SECONDS = 600;     // allow long interactive pauses
+static const int IDLE_RECHECK_SECONDS = 5;       // retry when an idle close was deferred
+static const int HEADER_TIMEOUT_SECONDS = 60;    // request line + headers must arrive in time
+static const int CHUNKED_TIMEOUT_SECONDS = 30;   // matches Client::processRequest
+static const long long CGI_POLL_INTERVAL_MS = 250; // exit/timeout check of a running CGI
+
+// How often resident memory is re-read for the memory_limit admission check
+static const long long MEMORY_SAMPLE_INTERVAL_MS = 100;
 
 Server* Server::instance = NULL;
+volatile sig_atomic_t Server::_pendingSignal = 0;
 
-Server::Server() : _running(false) {
+Server::Server() : _acceptBudget(ACCEPT_BUDGET), _acceptWakeups(0), _acceptedTotal(0), _maxAcceptsPerWakeup(0),
+                   _acceptBudgetExhausted(0), _workerConnections(MAX_CLIENTS), _keepAliveWatermark(MAX_CLIENTS),
+                   _memoryLimit(0), _residentMemory(0), _memorySampledAtMs(0), _shedConnections(0), _clientCount(0), _running(false),
+                   _workerProcesses(1), _isWorker(false),
+                   _workerThreads(1), _handoff(NULL), _contents(&_contentCache),
+                   _variants(&_variantCache), _offload(NULL) {
     instance = this;
 }
 
-Server::Server(const std::string& configFile) : _running(false) {
+Server::Server(const std::string& configFile) : _acceptBudget(ACCEPT_BUDGET), _acceptWakeups(0), _acceptedTotal(0),
+                                                _maxAcceptsPerWakeup(0), _acceptBudgetExhausted(0),
+                                                _workerConnections(MAX_CLIENTS), _keepAliveWatermark(MAX_CLIENTS),
+                                                _memoryLimit(0), _residentMemory(0), _memorySampledAtMs(0),
+                                                _shedConnections(0), _clientCount(0),
+                                                _running(false), _workerProcesses(1), _isWorker(false),
+                                                _workerThreads(1), _handoff(NULL),
+                                                _contents(&_contentCache), _variants(&_variantCache), _offload(NULL) {
     instance = this;
     loadConfig(configFile);
 }
 
+Server::Server(const Config& config) : _config(config), _acceptBudget(config.getAcceptBudget()), _acceptWakeups(0),
+                                       _acceptedTotal(0), _maxAcceptsPerWakeup(0), _acceptBudgetExhausted(0),
+                                       _workerConnections(config.getWorkerConnections()),
+                                       _keepAliveWatermark(config.getKeepAliveWatermark()), _memoryLimit(0),
+                                       _residentMemory(0), _memorySampledAtMs(0), _shedConnections(0), _clientCount(0), _running(false), _workerProcesses(1), _isWorker(false),
+                                       _workerThreads(1), _handoff(new HandoffQueue(HANDOFF_QUEUE_CAPACITY)),
+                                       _contents(&_contentCache), _variants(&_variantCache), _offload(NULL) {
+}
+
 // Server is intentionally non-copyable. Copy constructor and assignment
 // operator are declared private in the header and not defined here to
 // prevent accidental copying of heavy resources (sockets, clients, etc.).
 
 Server::~Server() {
     stop();
+    delete _handoff;
 }
 
 void Server::loadConfig(const std::string& configFile) {
@@ -34,14 +78,33 @@ const Config& Server::getConfig() const {
 void Server::start() {
     Logger::info("Starting webserver...");
     
-    // Setup signal handlers
-    signal(SIGINT, signalHandler);
-    signal(SIGTERM, signalHandler);
-    signal(SIGPIPE, SIG_IGN);
+    _installSignalHandlers();
+    _workerProcesses = _config.getWorkerProcesses();
+    _workerThreads = _config.getWorkerThreads();
+    _acceptBudget = _config.getAcceptBudget();
+    _workerConnections = _config.getWorkerConnections();
+    _clientPool.configure(_workerConnections, _config.getClientPoolBufferSize());
+    _fileCache.configure(_config.getOpenFileCache(), _config.getOpenFileCacheValid());
+    _contentCache.configure(_config.getContentCache(), _config.getContentCacheMaxEntry());
+    _variantCache.configure(_config.getCompressionCache());
+    _keepAliveWatermark = _config.getKeepAliveWatermark();
+    _memoryLimit = _config.getMemoryLimit();
+
+    // Serialized once: an overloaded server must not spend time building it.
+    // Date is optional on 5xx responses, so the canned copy carries none.
+    Response overload = Response::createErrorResponse(HTTP_SERVICE_UNAVAILABLE);
+    overload.removeHeader("Date");
+    overload.setHeader("Retry-After", Utils::intToString(_config.getRetryAfter()));
+    overload.setHeader("Connection", "close");
+    _overloadResponse = overload.toString();
     
     try {
-        _setupServerSockets();
+        // In multi-process mode every worker opens its own loop and
+        // listeners after fork(); the master holds no sockets at all.
         _running = true;
+        if (_workerProcesses <= 1) {
+            _startServing();
+        }
         Logger::info("Server started successfully");
     } catch (const std::exception& e) {
         Logger::error("Failed to start server: " + std::string(e.what()));
@@ -58,161 +121,249 @@ void Server::stop() {
     Logger::info("Server stopped");
 }
 
-// THIS IS THE CORRECT LOGIC
-// In src/Server.cpp
-
-// In src/Server.cpp
-
-// In src/Server.cpp
-
 void Server::run() {
-    // Main server loop
-    while (_running) { // Assuming _running is your loop control variable
-        _updatePollFds(); // Use your existing function to set up FDs
-
-        if (_pollFds.empty()) {
-            // No sockets to monitor, can happen if all connections are closed
-            // You might want a small sleep here to prevent a tight loop
-            continue;
-        }
+    if (_workerProcesses > 1 && !_isWorker) {
+        _superviseWorkers();
+        return;
+    }
+    _eventLoop();
+}
 
-        Logger::debug("Polling " + Utils::intToString(_pollFds.size()) + " file descriptors...");
-        int poll_count = poll(&_pollFds[0], _pollFds.size(), 100); // 100ms timeout for better responsiveness
+void Server::_eventLoop() {
+    // Main server loop: every fd stays registered with the event loop and only
+    // the fds that are actually ready are dispatched on each wakeup. The wait
+    // lasts until the next timer is due, so an idle server does not wake up.
+    while (_running) {
+        Utils::updateClock();
+        int timeoutMs = _timers.nextTimeoutMs(Utils::nowMs());
+        Logger::debug("Waiting on " + Utils::intToString(_loop.size()) + " file descriptors (" + EventLoop::getBackendName() + ", timeout " + Utils::intToString(timeoutMs) + "ms)...");
+        int readyCount = _loop.wait(timeoutMs);
 
-        if (poll_count < 0) {
+        if (readyCount < 0) {
             if (errno == EINTR) continue; // Interrupted by a signal, continue looping
-            Logger::error("poll() failed: " + std::string(strerror(errno)));
+            Logger::error(std::string(EventLoop::getBackendName()) + " wait failed: " + std::string(strerror(errno)));
             break; // Exit on critical poll error
         }
-        _checkCgiCompletion();
-        if (poll_count == 0) {
-            // poll() timed out. This is a good place to check for client timeouts.
-            _handleTimeout();
-            continue;
-        }
+        Utils::updateClock();
 
-        // Handle events on all file descriptors
-        _handlePollEvents();
+        // Handle events on the ready file descriptors only
+        if (readyCount > 0) {
+            _handlePollEvents();
+        }
+        _handleTimeout();
     }
+    if (this == instance) _logPendingSignal();
     _cleanup();
 }
 
-// You also need to implement _updatePollFds and _handlePollEvents.
-// Here is a complete, working implementation for them that fits your class structure.
-
-void Server::_updatePollFds() {
-    _pollFds.clear();
+// Dispatch table lookup: O(1) from a ready fd to its owner and role
+Server::FdSlot* Server::_getSlot(int fd) {
+    if (fd < 0 || (size_t)fd >= _fdTable.size() || _fdTable[fd].role == FD_NONE) {
+        return NULL;
+    }
+    return &_fdTable[fd];
+}
 
-    // 1. Add all listening server sockets
-    for (size_t i = 0; i < _serverSockets.size(); ++i) {
-        struct pollfd pfd = {_serverSockets[i], POLLIN, 0};
-        _pollFds.push_back(pfd);
+void Server::_bindSlot(int fd, FdRole role, Client* client) {
+    if (fd < 0) return;
+    if ((size_t)fd >= _fdTable.size()) {
+        FdSlot empty = {FD_NONE, NULL, -1, -1, -1};
+        _fdTable.resize(fd + 1, empty);
     }
+    FdSlot& slot = _fdTable[fd];
+    slot.role = role;
+    slot.client = client;
+    slot.cgiStdin = -1;
+    slot.cgiStdout = -1;
+    slot.listener = -1;
+}
 
-    // 2. Add all client sockets and their CGI pipes
-    for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
-        Client* client = it->second;
+void Server::_releaseSlot(int fd) {
+    if (fd < 0 || (size_t)fd >= _fdTable.size()) return;
+    _fdTable[fd].role = FD_NONE;
+    _fdTable[fd].client = NULL;
+    _fdTable[fd].cgiStdin = -1;
+    _fdTable[fd].cgiStdout = -1;
+}
 
-        // Add the client's main socket
-    struct pollfd client_pfd = {client->getFd(), POLLIN, 0};
-        if (client->getState() == Client::SENDING_RESPONSE || !client->getSendBuffer().empty()) {
-            client_pfd.events |= POLLOUT;
-        }
-        _pollFds.push_back(client_pfd);
+// Register, update or drop an fd so that its interest mask matches `events`.
+// A mask of 0 means the fd should not be watched at all.
+void Server::_watch(int fd, short events) {
+    if (fd < 0) return;
+    if (events == 0) {
+        _loop.remove(fd);
+    } else if (_loop.getInterest(fd) != events) {
+        _loop.modify(fd, events);
+    }
+}
 
-        // If client is waiting to write to a CGI, monitor its input pipe for writability
-        if (client->isWaitingForCgiWrite()) {
-            if (client->getCgi() && client->getCgi()->getInputFd() != -1) {
-                struct pollfd cgi_in_pfd = {client->getCgi()->getInputFd(), POLLOUT, 0};
-                _pollFds.push_back(cgi_in_pfd);
-            }
+void Server::_watchCgiPipe(Client* client, int& registeredFd, int fd, FdRole role, short events) {
+    if (events == 0) fd = -1;
+    if (registeredFd != fd) {
+        FdSlot* old = _getSlot(registeredFd);
+        // Only drop the old registration if the fd number has not already
+        // been handed to someone else
+        if (old && old->client == client && old->role == role) {
+            _loop.remove(registeredFd);
+            _releaseSlot(registeredFd);
         }
+        registeredFd = fd;
+        if (fd != -1) _bindSlot(fd, role, client);
+    }
+    _watch(fd, events);
+}
+
+// Bring the registered interest of a client's socket and CGI pipes in line
+// with its current state. Called after every callback that may change it.
+void Server::_updateInterest(Client* client) {
+    int clientFd = client->getFd();
+    FdSlot* slot = _getSlot(clientFd);
+    if (!slot) return;
+
+    // Once the peer has closed its side there is nothing left to read, and a
+    // level-triggered POLLIN would keep reporting EOF on every wait. A client
+    // parked on the worker pool reads nothing until its response is queued.
+    short socketEvents = (client->hasPeerClosed() || client->getState() == Client::WAITING_FOR_WORKER) ? 0 : POLLIN;
+    if (client->getState() == Client::SENDING_RESPONSE || !client->getSendBuffer().empty()) {
+        socketEvents |= POLLOUT;
+    }
+    _watch(clientFd, socketEvents);
 
+    CGI* cgi = client->getCgi();
+    short inEvents = 0;
+    short outEvents = 0;
+    int inFd = -1;
+    int outFd = -1;
+    if (cgi) {
+        inFd = cgi->getInputFd();
+        outFd = cgi->getOutputFd();
+        // If client is waiting to write to a CGI, monitor its input pipe for writability
+        if (client->isWaitingForCgiWrite() && inFd != -1) inEvents = POLLOUT;
         // If a CGI is running, monitor its output pipe for readability
-        if ((client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY) && client->getCgi()) {
-            if (client->getCgi()->getOutputFd() != -1) {
-                struct pollfd cgi_out_pfd = {client->getCgi()->getOutputFd(), POLLIN, 0};
-                _pollFds.push_back(cgi_out_pfd);
-            }
+        if ((client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY) && outFd != -1) {
+            outEvents = POLLIN;
         }
     }
+
+    // Copy the registered pipe fds out: binding a pipe slot may grow the
+    // table and invalidate `slot`.
+    int cgiStdin = slot->cgiStdin;
+    int cgiStdout = slot->cgiStdout;
+    _watchCgiPipe(client, cgiStdin, inFd, FD_CGI_STDIN, inEvents);
+    _watchCgiPipe(client, cgiStdout, outFd, FD_CGI_STDOUT, outEvents);
+    _fdTable[clientFd].cgiStdin = cgiStdin;
+    _fdTable[clientFd].cgiStdout = cgiStdout;
 }
 
-void Server::_handlePollEvents() {
-    // Check for new connections on server sockets first
-    for (size_t i = 0; i < _serverSockets.size(); ++i) {
-        short rev = _pollFds[i].revents;
-        if (rev) {
-            Logger::debug("Server socket fd=" + Utils::intToString(_serverSockets[i]) + ", revents=" + Utils::intToString(rev));
+void Server::_unwatchClient(int clientFd) {
+    FdSlot* slot = _getSlot(clientFd);
+    if (!slot) return;
+    int cgiStdin = slot->cgiStdin;
+    int cgiStdout = slot->cgiStdout;
+    _watchCgiPipe(slot->client, cgiStdin, -1, FD_CGI_STDIN, 0);
+    _watchCgiPipe(slot->client, cgiStdout, -1, FD_CGI_STDOUT, 0);
+    _loop.remove(clientFd);
+    _releaseSlot(clientFd);
+}
+
+void Server::_handleClientEvent(Client* client, short revents) {
+    int clientFd = client->getFd();
+
+    // Handle HUP/ERR carefully: if we still have data to send, try to flush it.
+    if (revents & (POLLHUP | POLLERR)) {
+        // Mark peer as closed to stop expecting more reads
+        client->markPeerClosed();
+        Logger::debug("Poll revents on client fd=" + Utils::intToString(clientFd) + ": HUP/ERR. sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().size()));
+        // Still attempt to send any remaining data
+        if (!client->getSendBuffer().empty()) {
+            client->sendData();
         }
-        if (rev & POLLIN) {
-            Logger::debug("POLLIN on server socket fd=" + Utils::intToString(_serverSockets[i]) + ", accepting connection");
-            _acceptNewConnection(_serverSockets[i]);
+        // If nothing to send, finish the client
+        if (client->getSendBuffer().empty()) {
+            client->setState(Client::FINISHED);
         }
+        return;
     }
 
+    // Handle POLLOUT before POLLIN to avoid a race where we
+    // finish sending a response, reset the client for
+    // keep-alive, and then accidentally clear any already-read
+    // bytes of the next pipelined request within the same
+    // poll iteration. Sending first allows the reset to occur
+    // before we read the next request, preserving correctness.
+    if (revents & POLLOUT) {
+        Logger::debug("POLLOUT on fd=" + Utils::intToString(clientFd) + ", sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().size()));
+        client->sendData();
+    }
+    if (revents & POLLIN) {
+        Logger::debug("POLLIN on fd=" + Utils::intToString(clientFd));
+        client->receiveData();
+        client->processRequest(_config);
+    }
+
+    // A peer that closed between requests will never send another one
+    if (client->hasPeerClosed() && client->getState() == Client::RECEIVING_REQUEST &&
+        client->getSendBuffer().empty()) {
+        client->setState(Client::FINISHED);
+    }
+}
+
+void Server::_handlePollEvents() {
     std::vector<int> clients_to_remove;
 
-    // Check for events on client sockets and CGI pipes
-    for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
-        Client* client = it->second;
-        int clientFd = it->first;
-
-        // Find the pollfd for the client's main socket, input pipe, and output pipe
-        for (size_t i = _serverSockets.size(); i < _pollFds.size(); ++i) {
-            int current_fd = _pollFds[i].fd;
-            short revents = _pollFds[i].revents;
-
-            if (revents == 0) continue;
-
-            // Event on the client's main socket
-                    if (current_fd == clientFd) {
-                // Handle HUP/ERR carefully: if we still have data to send, try to flush it.
-                        if (revents & (POLLHUP | POLLERR)) {
-                    // Mark peer as closed to stop expecting more reads
-                    client->markPeerClosed();
-                    Logger::debug("Poll revents on client fd=" + Utils::intToString(clientFd) + ": HUP/ERR. sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().length()));
-                    // Still attempt to send any remaining data
-                            if (!client->getSendBuffer().empty()) {
-                                client->sendData();
-                            }
-                    // If nothing to send, finish the client
-                    if (client->getSendBuffer().empty()) {
-                        client->setState(Client::FINISHED);
-                    }
-                } else {
-                    // Handle POLLOUT before POLLIN to avoid a race where we
-                    // finish sending a response, reset the client for
-                    // keep-alive, and then accidentally clear any already-read
-                    // bytes of the next pipelined request within the same
-                    // poll iteration. Sending first allows the reset to occur
-                    // before we read the next request, preserving correctness.
-                        if (revents & POLLOUT) {
-                            Logger::debug("POLLOUT on fd=" + Utils::intToString(clientFd) + ", sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().length()));
-                            client->sendData();
-                        }
-                        if (revents & POLLIN)  {
-                            Logger::debug("POLLIN on fd=" + Utils::intToString(clientFd));
-                            client->receiveData();
-                            client->processRequest(_config);
-                        }
-                }
+    for (size_t i = 0; i < _loop.getReadyCount(); ++i) {
+        const EventLoop::Event& event = _loop.getEvent(i);
+        int fd = event.fd;
+        short revents = event.revents;
+
+        FdSlot* slot = _getSlot(fd);
+        if (!slot) continue; // stale event for an fd we no longer own
+
+        if (slot->role == FD_LISTENER) {
+            // New connections on server sockets
+            Logger::debug("Server socket fd=" + Utils::intToString(fd) + ", revents=" + Utils::intToString(revents));
+            if (revents & POLLIN) {
+                _acceptNewConnection(fd, slot->listener);
             }
+            continue;
+        }
+        if (slot->role == FD_WAKEUP) {
+            // Connections handed over by the acceptor thread
+            _adoptHandedOffClients();
+            continue;
+        }
+        if (slot->role == FD_COMPLETION) {
+            _finishJobs();
+            continue;
+        }
 
-            // Events on the client's CGI pipes
-            if ((client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY) && client->getCgi()) {
-                if (current_fd == client->getCgi()->getInputFd() && (revents & POLLOUT)) {
+        Client* client = slot->client;
+        client->setKeepAliveAllowed(_clientCount < (size_t)_keepAliveWatermark);
+        switch (slot->role) {
+            case FD_CLIENT:
+                _handleClientEvent(client, revents);
+                break;
+            case FD_CGI_STDIN:
+                if ((revents & POLLOUT) && client->getCgi() && fd == client->getCgi()->getInputFd()) {
                     client->handleCgiInput();
                 }
-                if (current_fd == client->getCgi()->getOutputFd() && (revents & POLLIN)) {
+                break;
+            case FD_CGI_STDOUT:
+                if ((revents & POLLIN) && client->getCgi() && fd == client->getCgi()->getOutputFd()) {
                     client->handleCgiOutput();
                 }
-            }
+                break;
+            default:
+                break;
         }
+        _checkCgiCompletion(client);
 
         // Check if the client's state has changed to finished
         if (client->getState() == Client::FINISHED || client->getState() == Client::ERROR_STATE) {
-            clients_to_remove.push_back(clientFd);
+            clients_to_remove.push_back(client->getFd());
+        } else {
+            _updateInterest(client);
+            _updateTimers(client);
         }
     }
 
@@ -222,22 +373,254 @@ void Server::_handlePollEvents() {
     }
 }
 
+// Signal handlers are installed without SA_RESTART so that a blocking
+// waitpid() in the master or a wait in the event loop returns EINTR.
+void Server::_installSignalHandlers() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = signalHandler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+}
+
+// Master process: fork the configured number of workers, then block in
+// waitpid() and replace any worker that dies until asked to shut down.
+void Server::_superviseWorkers() {
+    Logger::info("Starting " + Utils::intToString(_workerProcesses) + " worker processes");
+    _workers.assign(_workerProcesses, -1);
+    _workerStartTimes.assign(_workerProcesses, 0);
+
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (!_spawnWorker(i)) return; // inside the worker: it has already served and shut down
+    }
+
+    while (_running) {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            Logger::error("waitpid() failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        size_t slot = 0;
+        while (slot < _workers.size() && _workers[slot] != pid) ++slot;
+        if (slot == _workers.size()) continue; // not one of ours
+        _workers[slot] = -1;
+        if (!_running) break;
+
+        std::string reason = WIFSIGNALED(status)
+            ? "killed by signal " + Utils::intToString(WTERMSIG(status))
+            : "exited with status " + Utils::intToString(WEXITSTATUS(status));
+        bool exitedEarly = time(NULL) - _workerStartTimes[slot] < WORKER_STARTUP_GRACE_SECONDS;
+        if (exitedEarly && WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+            Logger::error("Worker " + Utils::intToString(pid) + " failed to start (" + reason + "), shutting down");
+            _running = false;
+            break;
+        }
+        Logger::warn("Worker " + Utils::intToString(pid) + " " + reason + ", respawning");
+        if (!_spawnWorker(slot)) return;
+    }
+
+    _logPendingSignal();
+    _stopWorkers();
+}
+
+// Fork a worker into `slot`. Returns false in the child once it has finished
+// serving, so the caller unwinds back to main() without touching master state.
+bool Server::_spawnWorker(size_t slot) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        Logger::error("fork() failed for worker: " + std::string(strerror(errno)));
+        return true;
+    }
+
+    if (pid == 0) {
+#ifdef __linux__
+        // Do not outlive a master that was killed without a chance to clean up
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+        _isWorker = true;
+        _workers.clear();
+        _workerStartTimes.clear();
+        _startServing();
+        Logger::info("Worker " + Utils::intToString(getpid()) + " ready");
+        _eventLoop();
+        return false;
+    }
+
+    _workers[slot] = pid;
+    _workerStartTimes[slot] = time(NULL);
+    Logger::debug("Spawned worker " + Utils::intToString(pid));
+    return true;
+}
+
+void Server::_stopWorkers() {
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i] > 0) kill(_workers[i], SIGTERM);
+    }
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i] <= 0) continue;
+        while (waitpid(_workers[i], NULL, 0) < 0 && errno == EINTR) {}
+        _workers[i] = -1;
+    }
+    Logger::info("All workers stopped");
+}
+
+// Open the event loop and listeners of a serving process and, in threaded
+// mode, start the loop threads that will own its connections.
+void Server::_startServing() {
+    _loop.open();
+    _setupServerSockets();
+    if (_config.getThreadPool() > 0) {
+        _workerPool.start(_config.getThreadPool(), _config.getThreadPoolMaxQueue());
+        _offload = &_workerPool;
+    }
+    if (_workerThreads > 1) {
+        _startLoopThreads();
+    } else {
+        _openCompletions();
+    }
+}
+
+void Server::_startLoopThreads() {
+    Logger::info("Starting " + Utils::intToString(_workerThreads) + " event loop threads");
+
+    // Termination signals are handled by the acceptor thread only; loop
+    // threads inherit this mask and are stopped through their wakeup fd.
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    for (int i = 0; i < _workerThreads; ++i) {
+        Server* loop = new Server(_config);
+        // Connections are spread over the loops, so is the pool capacity
+        size_t poolCapacity = (_workerConnections + _workerThreads - 1) / _workerThreads;
+        loop->_clientPool.configure(poolCapacity, _config.getClientPoolBufferSize());
+        loop->_fileCache.configure(_config.getOpenFileCache(), _config.getOpenFileCacheValid());
+        // File contents and compressed variants are worth sharing: all
+        // loops use our caches, and our worker pool
+        loop->_contents = &_contentCache;
+        loop->_variants = &_variantCache;
+        loop->_offload = _offload;
+        loop->_keepAliveWatermark = (_keepAliveWatermark + _workerThreads - 1) / _workerThreads;
+        try {
+            loop->_loop.open();
+            int wakeFd = loop->_handoff->getWakeFd();
+            loop->_bindSlot(wakeFd, FD_WAKEUP, NULL);
+            loop->_loop.add(wakeFd, POLLIN);
+            loop->_openCompletions();
+        } catch (...) {
+            delete loop;
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+            throw;
+        }
+        loop->_running = true;
+        int err = pthread_create(&loop->_thread, NULL, _loopThreadMain, loop);
+        if (err != 0) {
+            loop->_running = false;
+            delete loop;
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+            throw std::runtime_error("pthread_create() failed: " + std::string(strerror(err)));
+        }
+        _loopThreads.push_back(loop);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+}
+
+void Server::_stopLoopThreads() {
+    for (size_t i = 0; i < _loopThreads.size(); ++i) {
+        _loopThreads[i]->_running = false;
+        _loopThreads[i]->_handoff->notify();
+    }
+    for (size_t i = 0; i < _loopThreads.size(); ++i) {
+        pthread_join(_loopThreads[i]->_thread, NULL);
+        delete _loopThreads[i];
+    }
+    if (!_loopThreads.empty()) {
+        Logger::info("All event loop threads stopped");
+    }
+    _loopThreads.clear();
+}
+
+void* Server::_loopThreadMain(void* arg) {
+    Server* loop = static_cast<Server*>(arg);
+    loop->_eventLoop();
+    return NULL;
+}
+
+// Connections owned by a loop thread, including ones still queued for it
+size_t Server::_getLoad() {
+    return __sync_fetch_and_add(&_clientCount, 0) + (_handoff ? _handoff->size() : 0);
+}
+
+// Acceptor side: queue the connection on the least-loaded loop thread
+void Server::_handOff(int clientSocket, int listener) {
+    Server* target = _loopThreads[0];
+    size_t targetLoad = target->_getLoad();
+    for (size_t i = 1; i < _loopThreads.size(); ++i) {
+        size_t load = _loopThreads[i]->_getLoad();
+        if (load < targetLoad) {
+            target = _loopThreads[i];
+            targetLoad = load;
+        }
+    }
+    if (!target->_handoff->push(clientSocket, listener)) {
+        Logger::warn("Handoff queue full, rejecting connection (fd: " + Utils::intToString(clientSocket) + ")");
+        close(clientSocket);
+        return;
+    }
+    target->_handoff->notify();
+}
+
+// Loop-thread side: take ownership of every connection queued so far
+void Server::_adoptHandedOffClients() {
+    _handoff->drainWakeups();
+    int clientSocket;
+    int listener;
+    while (_handoff->pop(clientSocket, listener)) {
+        _adoptClient(clientSocket, listener);
+    }
+}
+
+// The signal handler only records the signal; report it from normal context
+void Server::_logPendingSignal() {
+    if (_pendingSignal) {
+        Logger::info("Received signal " + Utils::intToString(_pendingSignal) + ", shutting down...");
+        _pendingSignal = 0;
+    }
+}
+
 bool Server::isRunning() const {
     return _running;
 }
 
+// One socket per distinct listen address; server blocks sharing it are
+// told apart by Host when the request is routed
 void Server::_setupServerSockets() {
-    for (Config::ServerIterator it = _config.begin(); it != _config.end(); ++it) {
-        const Config::ServerBlock& server = *it;
+    const std::vector<Config::Listener>& listeners = _config.getListeners();
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        const Config::Listener& listener = listeners[i];
         
         try {
-            int serverSocket = _createServerSocket(Config::getHost(server), Config::getPort(server));
+            int serverSocket = _createServerSocket(listener.host, listener.port);
             _serverSockets.push_back(serverSocket);
+            _bindSlot(serverSocket, FD_LISTENER, NULL);
+            _fdTable[serverSocket].listener = (int)i;
+            _loop.add(serverSocket, POLLIN);
             
-            Logger::info("Listening on " + Config::getHost(server) + ":" + Utils::intToString(Config::getPort(server)));
+            Logger::info("Listening on " + listener.host + ":" + Utils::intToString(listener.port) + " (" +
+                         Utils::sizeToString(listener.servers) + " server block(s))");
         } catch (const std::exception& e) {
             Logger::error("Failed to create server socket for " + 
-                         Config::getHost(server) + ":" + Utils::intToString(Config::getPort(server)) + 
+                         listener.host + ":" + Utils::intToString(listener.port) + 
                          ": " + std::string(e.what()));
             throw;
         }
@@ -261,6 +644,21 @@ int Server::_createServerSocket(const std::string& host, int port) {
         throw std::runtime_error("Failed to set SO_REUSEADDR");
     }
     
+    // Each worker binds its own listener; the kernel spreads connections
+    // across them. Only enabled in worker mode so that a second standalone
+    // instance still fails to bind an occupied port.
+    if (_isWorker) {
+#ifdef SO_REUSEPORT
+        if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+            close(serverSocket);
+            throw std::runtime_error("Failed to set SO_REUSEPORT");
+        }
+#else
+        close(serverSocket);
+        throw std::runtime_error("worker_processes requires SO_REUSEPORT support");
+#endif
+    }
+    
     // Optimize socket buffers for better performance
     int rcvbuf = 262144;  // 256KB receive buffer
     int sndbuf = 262144;  // 256KB send buffer
@@ -270,9 +668,17 @@ int Server::_createServerSocket(const std::string& host, int port) {
     if (setsockopt(serverSocket, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
         Logger::warn("Failed to set SO_SNDBUF");
     }
+
+    // Enable TCP_NODELAY to reduce latency. Accepted sockets inherit this and
+    // the buffer sizes above, which saves three setsockopt() calls per client.
+    int nodelay = 1;
+    if (setsockopt(serverSocket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0) {
+        Logger::warn("Failed to set TCP_NODELAY");
+    }
     
-    // Set non-blocking
+    // Set non-blocking and keep the listener out of CGI children
     Utils::setNonBlocking(serverSocket);
+    Utils::setCloseOnExec(serverSocket);
     
     // Bind socket
     struct sockaddr_in serverAddr;
@@ -303,70 +709,132 @@ int Server::_createServerSocket(const std::string& host, int port) {
     return serverSocket;
 }
 
-void Server::_acceptNewConnection(int serverSocket) {
-    struct sockaddr_in clientAddr;
-    socklen_t clientAddrLen = sizeof(clientAddr);
-    
-    int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
-    if (clientSocket < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            Logger::error("Failed to accept connection: " + std::string(strerror(errno)));
+// Drain a listener's backlog: keep accepting until it is empty or this
+// wakeup's budget is spent. Any leftover connections keep the listener ready,
+// so the next wait returns immediately without starving established clients.
+void Server::_acceptNewConnection(int serverSocket, int listener) {
+    size_t accepted = 0;
+    while (accepted < (size_t)_acceptBudget) {
+        struct sockaddr_in clientAddr;
+        socklen_t clientAddrLen = sizeof(clientAddr);
+
+#ifdef __linux__
+        int clientSocket = accept4(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrLen);
+#endif
+        if (clientSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                Logger::error("Failed to accept connection: " + std::string(strerror(errno)));
+            }
+            break;
+        }
+        ++accepted;
+#ifndef __linux__
+        // Set client socket to non-blocking and keep it out of CGI children
+        Utils::setNonBlocking(clientSocket);
+        Utils::setCloseOnExec(clientSocket);
+#endif
+
+        size_t activeClients = _clientCount;
+        for (size_t i = 0; i < _loopThreads.size(); ++i) {
+            activeClients += _loopThreads[i]->_getLoad();
+        }
+        if (_isOverloaded(activeClients)) {
+            _rejectOverloaded(clientSocket);
+            continue;
+        }
+
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
+        Logger::info("New connection from " + std::string(clientIP) + " (fd: " + Utils::intToString(clientSocket) + ")");
+
+        // Buffer sizes and TCP_NODELAY are inherited from the listener
+        if (!_loopThreads.empty()) {
+            _handOff(clientSocket, listener);
+        } else {
+            _adoptClient(clientSocket, listener);
         }
-        return;
     }
-    
-    if (_clients.size() >= MAX_CLIENTS) {
+    _recordAcceptBatch(accepted);
+}
+
+// Hard admission limits: connection count and (sampled) resident memory
+bool Server::_isOverloaded(size_t activeClients) {
+    if (activeClients >= (size_t)_workerConnections) {
         Logger::warn("Maximum clients reached, rejecting connection");
-        close(clientSocket);
-        return;
+        return true;
     }
-    
-    char clientIP[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
-    
-    Logger::info("New connection from " + std::string(clientIP) + " (fd: " + Utils::intToString(clientSocket) + ")");
-    
-    // Set client socket to non-blocking
-    Utils::setNonBlocking(clientSocket);
-    
-    // Optimize client socket for better performance
-    int rcvbuf = 262144;  // 256KB receive buffer
-    int sndbuf = 262144;  // 256KB send buffer
-    if (setsockopt(clientSocket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
-        Logger::debug("Failed to set client SO_RCVBUF");
+    if (_memoryLimit == 0) return false;
+    // Reading /proc on every accept would be wasteful during a storm
+    long long nowMs = Utils::nowMs();
+    if (_memorySampledAtMs == 0 || nowMs - _memorySampledAtMs >= MEMORY_SAMPLE_INTERVAL_MS) {
+        _residentMemory = Utils::getResidentMemory();
+        _memorySampledAtMs = nowMs;
     }
-    if (setsockopt(clientSocket, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) < 0) {
-        Logger::debug("Failed to set client SO_SNDBUF");
+    if (_residentMemory > _memoryLimit) {
+        Logger::warn("Memory limit reached (" + Utils::intToString((int)(_residentMemory / 1024)) + " KB resident), rejecting connection");
+        return true;
     }
-    
-    // Enable TCP_NODELAY to reduce latency
-    int nodelay = 1;
-    if (setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) < 0) {
-        Logger::debug("Failed to set TCP_NODELAY");
-    }
-
-    // Try to read the kernel-level fd target (/proc/self/fd/<fd>) to capture socket inode like "socket:[12345]"
-    char fdPath[64];
-    char linkTarget[256];
-    snprintf(fdPath, sizeof(fdPath), "/proc/self/fd/%d", clientSocket);
-    ssize_t linkLen = readlink(fdPath, linkTarget, sizeof(linkTarget) - 1);
-    if (linkLen != -1) {
-        linkTarget[linkLen] = '\0';
-        Logger::debug(std::string("Accepted fd link: ") + fdPath + " -> " + linkTarget);
-    } else {
-        Logger::debug(std::string("Accepted fd link: ") + fdPath + " -> (readlink failed: " + std::string(strerror(errno)) + ")");
+    return false;
+}
+
+// Answer with the canned 503 without reading the request. The socket is
+// non-blocking and the response is far smaller than a socket buffer, so a
+// single send() normally takes all of it; a short write is simply dropped.
+void Server::_rejectOverloaded(int clientSocket) {
+    ++_shedConnections;
+    ssize_t sent = send(clientSocket, _overloadResponse.data(), _overloadResponse.size(), MSG_NOSIGNAL);
+    if (sent < 0) {
+        Logger::debug("Failed to send overload response: " + std::string(strerror(errno)));
     }
-    
-    // Allocate Client on the heap to ensure single owner semantics
-    Client* newClient = new Client(clientSocket);
-    _clients[clientSocket] = newClient;
+    // Discard whatever request bytes already arrived: closing with unread
+    // data would reset the connection and could destroy the 503 in flight.
+    shutdown(clientSocket, SHUT_WR);
+    char discard[4096];
+    while (recv(clientSocket, discard, sizeof(discard), 0) > 0) {}
+    close(clientSocket);
+}
+
+void Server::_recordAcceptBatch(size_t accepted) {
+    ++_acceptWakeups;
+    _acceptedTotal += accepted;
+    if (accepted > _maxAcceptsPerWakeup) _maxAcceptsPerWakeup = accepted;
+    if (accepted >= (size_t)_acceptBudget) ++_acceptBudgetExhausted;
+    Logger::debug("Accepted " + Utils::intToString((int)accepted) + " connection(s) in this wakeup (budget " + Utils::intToString(_acceptBudget) + ")");
+}
+
+void Server::_logAcceptStats() const {
+    if (_acceptWakeups == 0) return;
+    std::ostringstream stats;
+    stats << "Accept stats: " << _acceptedTotal << " connections over " << _acceptWakeups << " wakeups (avg "
+          << std::fixed << std::setprecision(2) << (double)_acceptedTotal / _acceptWakeups
+          << ", max " << _maxAcceptsPerWakeup << ", budget exhausted " << _acceptBudgetExhausted << " times)";
+    Logger::info(stats.str());
+    if (_shedConnections > 0) {
+        Logger::info("Rejected " + Utils::intToString((int)_shedConnections) + " connections with 503 while overloaded");
+    }
+}
+
+void Server::_adoptClient(int clientSocket, int listener) {
+    // Clients are recycled through the pool; the fd table owns the pointer
+    Client* newClient = _clientPool.acquire(clientSocket, listener);
+    newClient->setFileCache(&_fileCache);
+    newClient->setContentCache(_contents);
+    newClient->setVariantCache(_variants->isEnabled() ? _variants : NULL);
+    newClient->setWorkerPool(_offload, &_completions);
+    _bindSlot(clientSocket, FD_CLIENT, newClient);
+    __sync_fetch_and_add(&_clientCount, 1);
+    _updateInterest(newClient);
+    _updateTimers(newClient);
 }
 
 void Server::_handleClientRead(int clientFd) {
-    std::map<int, Client*>::iterator it = _clients.find(clientFd);
-    if (it == _clients.end()) return;
+    FdSlot* slot = _getSlot(clientFd);
+    if (!slot || slot->role != FD_CLIENT) return;
     
-    Client* client = it->second;
+    Client* client = slot->client;
     ssize_t bytesRead = client->receiveData();
     
     // Close connection if client disconnected or there's a real error
@@ -382,10 +850,10 @@ void Server::_handleClientRead(int clientFd) {
 }
 
 void Server::_handleClientWrite(int clientFd) {
-    std::map<int, Client*>::iterator it = _clients.find(clientFd);
-    if (it == _clients.end()) return;
+    FdSlot* slot = _getSlot(clientFd);
+    if (!slot || slot->role != FD_CLIENT) return;
     
-    Client* client = it->second;
+    Client* client = slot->client;
     ssize_t bytesSent = client->sendData();
     
     if (bytesSent < 0 || client->getState() == Client::FINISHED || client->getState() == Client::ERROR_STATE) {
@@ -394,69 +862,186 @@ void Server::_handleClientWrite(int clientFd) {
 }
 
 void Server::_closeClient(int clientFd) {
-    std::map<int, Client*>::iterator it = _clients.find(clientFd);
-    if (it != _clients.end()) {
-    Logger::debug("Closing client connection (fd: " + Utils::intToString(clientFd) + ", state=" + Utils::intToString((int)it->second->getState()) + ", lastActivity=" + Utils::intToString((int)it->second->getLastActivity()) + ", sendBufferLen=" + Utils::intToString((int)it->second->getSendBuffer().length()) + ")");
-        it->second->close();
-        delete it->second;
-        _clients.erase(it);
+    FdSlot* slot = _getSlot(clientFd);
+    if (slot && slot->role == FD_CLIENT) {
+        Client* client = slot->client;
+    Logger::debug("Closing client connection (fd: " + Utils::intToString(clientFd) + ", state=" + Utils::intToString((int)client->getState()) + ", lastActivity=" + Utils::intToString((int)client->getLastActivity()) + ", sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().size()) + ")");
+        _unwatchClient(clientFd);
+        _cancelTimers(client);
+        client->close();
+        _clientPool.release(client);
+        __sync_fetch_and_sub(&_clientCount, 1);
     }
 }
 
+// Arm, re-arm or cancel each of a client's timers to match its current state.
+// Called after every callback that may change it.
+void Server::_updateTimers(Client* client) {
+    long long nowMs = Utils::nowMs();
+    const Request& request = client->getRequest();
+
+    // Idle: armed at the last activity seen; activity since then is picked
+    // up lazily when it fires, so busy connections never touch the wheel.
+    TimerWheel::Timer& idle = client->getTimer(Client::TIMER_IDLE);
+    if (!idle.isArmed()) {
+        _timers.schedule(idle, ((long long)client->getLastActivity() + IDLE_TIMEOUT_SECONDS + 1) * 1000);
+    }
+
+    // Header: a fixed deadline from the first byte of the request head
+    TimerWheel::Timer& header = client->getTimer(Client::TIMER_HEADER);
+    if (!request.hasPendingHeaders()) {
+        _timers.cancel(header);
+    } else if (!header.isArmed()) {
+        _timers.schedule(header, nowMs + HEADER_TIMEOUT_SECONDS * 1000LL);
+    }
+
+    // Chunked upload: inactivity since the last chunk arrived
+    TimerWheel::Timer& chunked = client->getTimer(Client::TIMER_CHUNKED);
+    if (request.isChunked() && !request.isComplete() && request.getChunkStartTime() != 0) {
+        if (!chunked.isArmed()) {
+            _timers.schedule(chunked, ((long long)request.getChunkStartTime() + CHUNKED_TIMEOUT_SECONDS + 1) * 1000);
+        }
+    } else {
+        _timers.cancel(chunked);
+    }
+
+    // CGI: poll the child for exit and inactivity while it runs
+    TimerWheel::Timer& cgi = client->getTimer(Client::TIMER_CGI);
+    if (client->getCgi() && (client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY)) {
+        if (!cgi.isArmed()) {
+            _timers.schedule(cgi, nowMs + CGI_POLL_INTERVAL_MS);
+        }
+    } else {
+        _timers.cancel(cgi);
+    }
+}
+
+void Server::_cancelTimers(Client* client) {
+    for (int kind = 0; kind < Client::TIMER_COUNT; ++kind) {
+        _timers.cancel(client->getTimer(static_cast<Client::TimerKind>(kind)));
+    }
+}
+
+// Returns true when the idle timeout should close the client now
+bool Server::_isIdleExpired(Client* client) {
+    TimerWheel::Timer& idle = client->getTimer(Client::TIMER_IDLE);
+    int fd = client->getFd();
+
+    if (!client->hasTimedOut(IDLE_TIMEOUT_SECONDS)) {
+        // There was activity since the timer was armed: push the deadline out
+        _timers.schedule(idle, ((long long)client->getLastActivity() + IDLE_TIMEOUT_SECONDS + 1) * 1000);
+        return false;
+    }
+
+    // Avoid closing clients that are actively sending a response with
+    // remaining data in their send buffer, still streaming a request body,
+    // or waiting on a running CGI: closing them causes truncated responses
+    // (unexpected EOF) or false timeouts. Check again a little later.
+    bool deferred = false;
+    if (!client->getRequest().isComplete() && client->getRequest().isStreamingMode()) {
+        Logger::debug("Skipping timeout close for client " + Utils::intToString(fd) + " because it is still uploading request body");
+        deferred = true;
+    } else if ((client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY) &&
+               client->getCgi() && client->getCgi()->isRunning()) {
+        Logger::debug("Skipping timeout close for client " + Utils::intToString(fd) + " because CGI is running (state=" + Utils::intToString((int)client->getState()) + ")");
+        deferred = true;
+    } else if (client->getState() == Client::WAITING_FOR_WORKER) {
+        Logger::debug("Skipping timeout close for client " + Utils::intToString(fd) + " because its response is being compressed");
+        deferred = true;
+    } else if (client->getState() == Client::SENDING_RESPONSE && !client->getSendBuffer().empty()) {
+        Logger::debug("Skipping timeout close for client " + Utils::intToString(fd) + " because it is actively sending response (sendBufferLen=" + Utils::intToString((int)client->getSendBuffer().size()) + ")");
+        deferred = true;
+    }
+    if (deferred) {
+        _timers.schedule(idle, Utils::nowMs() + IDLE_RECHECK_SECONDS * 1000LL);
+        return false;
+    }
+    return true;
+}
+
+// Fire every timer that has come due. Only clients with an expired timer are
+// touched; closes are deferred until the whole batch has been dispatched
+// because several timers of the same client can expire together.
 void Server::_handleTimeout() {
+    _expiredTimers.clear();
+    _timers.advance(Utils::nowMs(), _expiredTimers);
+    if (_expiredTimers.empty()) return;
+
     std::vector<int> clientsToClose;
-    
-    for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
-        // If the client appears to have timed out, consider closing it.
-        // However, avoid closing clients that are actively sending a response
-        // with remaining data in their send buffer — closing them causes the
-        // client to receive a truncated response (unexpected EOF). Instead,
-        // let the normal send loop continue until the send buffer drains or
-        // the connection truly becomes idle for a longer period.
-        // Use a more generous idle timeout to accommodate slow large uploads
-    const int IDLE_TIMEOUT_SECONDS = 600; // allow long interactive pauses
-    if (it->second->hasTimedOut(IDLE_TIMEOUT_SECONDS)) {
-            // If the client is still streaming a request body (e.g., large POST)
-            // and the request isn't complete yet, do not close on idle timeout.
-            if (!it->second->getRequest().isComplete() && it->second->getRequest().isStreamingMode()) {
-                Logger::debug("Skipping timeout close for client " + Utils::intToString(it->first) + " because it is still uploading request body");
-                continue;
-            }
-            // If the client is in the middle of CGI processing or streaming
-            // and the CGI child is still running, do not close the client.
-            // Long uploads may complete well before the CGI finishes, so
-            // closing here causes truncated responses or false timeouts.
-            if ((it->second->getState() == Client::CGI_PROCESSING || it->second->getState() == Client::CGI_STREAMING_BODY) &&
-                it->second->getCgi() && it->second->getCgi()->isRunning()) {
-                Logger::debug("Skipping timeout close for client " + Utils::intToString(it->first) + " because CGI is running (state=" + Utils::intToString((int)it->second->getState()) + ")");
-                continue;
-            }
+    for (size_t i = 0; i < _expiredTimers.size(); ++i) {
+        TimerWheel::Timer* timer = _expiredTimers[i];
+        Client* client = static_cast<Client*>(timer->owner);
+        int fd = client->getFd();
+        if (client->getState() == Client::FINISHED || client->getState() == Client::ERROR_STATE) {
+            continue; // already queued for closing
+        }
 
-            // Also skip closing if we're currently in SENDING_RESPONSE and there
-            // is still data left to send. This prevents premature EOF for
-            // large responses (e.g., CGI-generated bodies).
-            if (it->second->getState() == Client::SENDING_RESPONSE && !it->second->getSendBuffer().empty()) {
-                Logger::debug("Skipping timeout close for client " + Utils::intToString(it->first) + " because it is actively sending response (sendBufferLen=" + Utils::intToString((int)it->second->getSendBuffer().length()) + ")");
-                continue;
-            }
+        switch (timer->kind) {
+            case Client::TIMER_IDLE:
+                if (_isIdleExpired(client)) {
+                    Logger::debug("Client " + Utils::intToString(fd) + " timed out");
+                    client->setState(Client::FINISHED);
+                }
+                break;
+            case Client::TIMER_HEADER:
+                if (client->getRequest().hasPendingHeaders()) {
+                    Logger::warn("Client " + Utils::intToString(fd) + " did not send request headers within " + Utils::intToString(HEADER_TIMEOUT_SECONDS) + " seconds");
+                    client->setState(Client::FINISHED);
+                }
+                break;
+            case Client::TIMER_CHUNKED:
+                // processRequest() answers 408 once the upload has stalled
+                client->setKeepAliveAllowed(_clientCount < (size_t)_keepAliveWatermark);
+                client->processRequest(_config);
+                break;
+            case Client::TIMER_CGI:
+                _checkCgiCompletion(client);
+                break;
+            default:
+                break;
+        }
 
-            clientsToClose.push_back(it->first);
+        if (client->getState() == Client::FINISHED || client->getState() == Client::ERROR_STATE) {
+            clientsToClose.push_back(fd);
+        } else {
+            _updateInterest(client);
+            _updateTimers(client);
         }
     }
-    
+
     for (size_t i = 0; i < clientsToClose.size(); ++i) {
-            Logger::debug("Client " + Utils::intToString(clientsToClose[i]) + " timed out");
         _closeClient(clientsToClose[i]);
     }
 }
 
 void Server::_cleanup() {
+    // Before the loops go: jobs still queued are handed back to them unrun
+    _workerPool.stop();
+    _stopLoopThreads();
+    _logAcceptStats();
+
     // Close all client connections
-    for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
-        it->second->close();
-        delete it->second;
+    for (size_t fd = 0; fd < _fdTable.size(); ++fd) {
+        if (_fdTable[fd].role != FD_CLIENT) continue;
+        _cancelTimers(_fdTable[fd].client);
+        _fdTable[fd].client->close();
+        _clientPool.release(_fdTable[fd].client);
+        __sync_fetch_and_sub(&_clientCount, 1);
+    }
+    _fdTable.clear();
+    _completions.close();
+    _clientPool.logStats();
+    _fileCache.logStats();
+    _fileCache.clear();
+    if (_contents == &_contentCache) {
+        _contentCache.logStats();
+        _contentCache.clear();
+    }
+    if (_variants == &_variantCache) {
+        _variantCache.logStats();
+        _variantCache.clear();
+        _workerPool.logStats();
     }
-    _clients.clear();
     
     // Close server sockets
     for (size_t i = 0; i < _serverSockets.size(); ++i) {
@@ -464,73 +1049,100 @@ void Server::_cleanup() {
     }
     _serverSockets.clear();
     
-    _pollFds.clear();
+    _loop.close();
 }
 
-void Server::_checkCgiCompletion() {
-    for (std::map<int, Client*>::iterator it = _clients.begin(); it != _clients.end(); ++it) {
-        Client* client = it->second;
-        if ((client->getState() == Client::CGI_PROCESSING || client->getState() == Client::CGI_STREAMING_BODY) && client->getCgi()) {
-            CGI* cgi = client->getCgi();
-            
-            // Check if CGI has finished OR appears to have timed out.
-            // Only treat as timed out if both the CGI shows inactivity
-            // and the client connection itself has been idle for the
-            // same timeout period. This avoids finalizing the CGI while
-            // the client is still uploading a large request body.
-            // Don't finalize a CGI timeout while the client is still in the
-            // middle of uploading (CGI_PROCESSING). Only treat as timed out
-            // when the CGI timed out and the client is no longer in
-            // CGI_PROCESSING (or is otherwise idle).
-            bool cgiFinished = cgi->isFinished();
-            bool cgiTimedOut = cgi->hasTimedOut(600); // 10 minutes for large uploads
-            bool clientIdle = client->hasTimedOut(30);
-            time_t now = time(NULL);
-            time_t secondsSinceClientActivity = now - client->getLastActivity();
-
-            Logger::debug("Server::_checkCgiCompletion: client=" + Utils::intToString(it->first) + ", cgiFinished=" + std::string(cgiFinished ? "true" : "false") + ", cgiTimedOut=" + std::string(cgiTimedOut ? "true" : "false") + ", clientState=" + Utils::intToString(client->getState()) + ", clientIdle=" + std::string(clientIdle ? "true" : "false") + ", secSinceActivity=" + Utils::intToString((int)secondsSinceClientActivity));
-
-            // Only finalize on CGI timeout if the client has been idle for the
-            // configured timeout AND a short grace period has passed since the
-            // client's last activity. This avoids races where the client is
-            // actively uploading and the CGI appears inactive for an instant.
-            // Only finalize if either:
-            // - the CGI finished and the client request is complete or the client
-            //   is already idle (no more data expected), OR
-            // - the CGI timed out and the client has been idle long enough
-            //   (to avoid racing with ongoing uploads).
-            if (cgiFinished || (cgiTimedOut && clientIdle)) {
-                Logger::debug("CGI completion or timeout detected for client " + Utils::intToString(it->first));
-                // Read any remaining bytes from CGI
-                client->handleCgiOutput();
-
-                // IMPORTANT: If CGI finished but the client request is not complete yet,
-                // defer finalization until the upload completes to avoid closing the
-                // connection while the client is still writing (broken pipe).
-                if (cgiFinished && !client->getRequest().isComplete()) {
-                    Logger::debug("Deferring CGI finalization: client still uploading request body.");
-                    continue;
-                }
+// Give the worker pool's completion eventfd a slot in this loop
+void Server::_openCompletions() {
+    _completions.open();
+    int fd = _completions.getWakeFd();
+    _bindSlot(fd, FD_COMPLETION, NULL);
+    _loop.add(fd, POLLIN);
+}
 
-                // Finalize the response now. However, handleCgiOutput() may
-                // already have finalized and cleaned up the CGI (clearing the
-                // client's CGI pointer). Re-check the client's CGI pointer and
-                // state to avoid calling finalizeCgiResponse() twice.
-                if (client->getState() != Client::FINISHED && client->getState() != Client::ERROR_STATE) {
-                    if (client->getCgi() == NULL) {
-                        Logger::debug("Server::_checkCgiCompletion: CGI already finalized by handleCgiOutput(), skipping finalizeCgiResponse\n");
-                    } else {
-                        client->finalizeCgiResponse();
-                    }
-                }
+// Jobs the worker pool has finished: resume the clients parked on them.
+// A job whose client went away meanwhile is only released.
+void Server::_finishJobs() {
+    std::vector<WorkerPool::Job*> jobs;
+    _completions.drain(jobs);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        Client* client = static_cast<Client*>(jobs[i]->owner);
+        if (client) {
+            client->finishJob(jobs[i]);
+            if (client->getState() == Client::FINISHED || client->getState() == Client::ERROR_STATE) {
+                _closeClient(client->getFd());
+            } else {
+                _updateInterest(client);
+                _updateTimers(client);
+            }
+        }
+        delete jobs[i];
+    }
+}
+
+// Detect a CGI child that exited or stalled without a final pipe event and
+// finish its response. Runs after each event and on the client's CGI timer.
+void Server::_checkCgiCompletion(Client* client) {
+    if ((client->getState() != Client::CGI_PROCESSING && client->getState() != Client::CGI_STREAMING_BODY) || !client->getCgi()) {
+        return;
+    }
+    int fd = client->getFd();
+    CGI* cgi = client->getCgi();
+
+    // Check if CGI has finished OR appears to have timed out.
+    // Only treat as timed out if both the CGI shows inactivity
+    // and the client connection itself has been idle for the
+    // same timeout period. This avoids finalizing the CGI while
+    // the client is still uploading a large request body.
+    // Don't finalize a CGI timeout while the client is still in the
+    // middle of uploading (CGI_PROCESSING). Only treat as timed out
+    // when the CGI timed out and the client is no longer in
+    // CGI_PROCESSING (or is otherwise idle).
+    bool cgiFinished = cgi->isFinished();
+    bool cgiTimedOut = cgi->hasTimedOut(600); // 10 minutes for large uploads
+    bool clientIdle = client->hasTimedOut(30);
+    time_t now = Utils::now();
+    time_t secondsSinceClientActivity = now - client->getLastActivity();
+
+    Logger::debug("Server::_checkCgiCompletion: client=" + Utils::intToString((int)fd) + ", cgiFinished=" + std::string(cgiFinished ? "true" : "false") + ", cgiTimedOut=" + std::string(cgiTimedOut ? "true" : "false") + ", clientState=" + Utils::intToString(client->getState()) + ", clientIdle=" + std::string(clientIdle ? "true" : "false") + ", secSinceActivity=" + Utils::intToString((int)secondsSinceClientActivity));
+
+    // Only finalize on CGI timeout if the client has been idle for the
+    // configured timeout AND a short grace period has passed since the
+    // client's last activity. This avoids races where the client is
+    // actively uploading and the CGI appears inactive for an instant.
+    // Only finalize if either:
+    // - the CGI finished and the client request is complete or the client
+    //   is already idle (no more data expected), OR
+    // - the CGI timed out and the client has been idle long enough
+    //   (to avoid racing with ongoing uploads).
+    if (cgiFinished || (cgiTimedOut && clientIdle)) {
+        Logger::debug("CGI completion or timeout detected for client " + Utils::intToString((int)fd));
+        // Read any remaining bytes from CGI
+        client->handleCgiOutput();
+
+        // IMPORTANT: If CGI finished but the client request is not complete yet,
+        // defer finalization until the upload completes to avoid closing the
+        // connection while the client is still writing (broken pipe).
+        if (cgiFinished && !client->getRequest().isComplete()) {
+            Logger::debug("Deferring CGI finalization: client still uploading request body.");
+        } else if (client->getState() != Client::FINISHED && client->getState() != Client::ERROR_STATE) {
+            // Finalize the response now. However, handleCgiOutput() may
+            // already have finalized and cleaned up the CGI (clearing the
+            // client's CGI pointer). Re-check the client's CGI pointer and
+            // state to avoid calling finalizeCgiResponse() twice.
+            if (client->getCgi() == NULL) {
+                Logger::debug("Server::_checkCgiCompletion: CGI already finalized by handleCgiOutput(), skipping finalizeCgiResponse\n");
+            } else {
+                client->finalizeCgiResponse();
             }
         }
     }
 }
 
+// Async-signal context: only record the request, the loop logs it
 void Server::signalHandler(int signal) {
     if (instance) {
-        Logger::info("Received signal " + Utils::intToString(signal) + ", shutting down...");
+        _pendingSignal = signal;
         instance->_running = false;
     }
 }
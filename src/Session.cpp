@@ -1,10 +1,14 @@
 #include "Session.hpp"
 #include "Utils.hpp"
 #include "Logger.hpp"
+#include <pthread.h>
 
 // Static member initialization
 std::map<std::string, Session> Session::_sessions;
 
+// Guards _sessions: with worker_threads every event-loop thread shares it
+static pthread_mutex_t g_sessionsMutex = PTHREAD_MUTEX_INITIALIZER;
+
 Session::Session() : _maxAge(3600), _isValid(false) {
     _createdAt = _lastAccessed = time(NULL);
 }
@@ -89,53 +93,72 @@ Cookie Session::createSessionCookie() const {
 }
 
 // Static session management
+// Returned pointers refer to the shared table and stay valid until the
+// session is destroyed.
 Session* Session::getSession(const std::string& sessionId) {
+    Session* session = NULL;
+    pthread_mutex_lock(&g_sessionsMutex);
     std::map<std::string, Session>::iterator it = _sessions.find(sessionId);
     if (it != _sessions.end() && it->second.isValid()) {
         it->second.touch();
-        return &it->second;
+        session = &it->second;
     }
-    return NULL;
+    pthread_mutex_unlock(&g_sessionsMutex);
+    return session;
 }
 
 Session* Session::createSession() {
+    pthread_mutex_lock(&g_sessionsMutex);
     std::string sessionId = _generateSessionId();
     Session session(sessionId);
     _sessions[sessionId] = session;
+    Session* created = &_sessions[sessionId];
+    pthread_mutex_unlock(&g_sessionsMutex);
     Logger::debug("Created new session: " + sessionId);
-    return &_sessions[sessionId];
+    return created;
 }
 
 void Session::destroySession(const std::string& sessionId) {
+    bool destroyed = false;
+    pthread_mutex_lock(&g_sessionsMutex);
     std::map<std::string, Session>::iterator it = _sessions.find(sessionId);
     if (it != _sessions.end()) {
         it->second.destroy();
         _sessions.erase(it);
+        destroyed = true;
+    }
+    pthread_mutex_unlock(&g_sessionsMutex);
+    if (destroyed) {
         Logger::debug("Destroyed session: " + sessionId);
     }
 }
 
 void Session::cleanupExpiredSessions() {
-    std::vector<std::string> expiredSessions;
+    size_t expiredCount = 0;
     
-    for (std::map<std::string, Session>::iterator it = _sessions.begin(); 
-         it != _sessions.end(); ++it) {
+    pthread_mutex_lock(&g_sessionsMutex);
+    std::map<std::string, Session>::iterator it = _sessions.begin();
+    while (it != _sessions.end()) {
         if (it->second.isExpired()) {
-            expiredSessions.push_back(it->first);
+            it->second.destroy();
+            _sessions.erase(it++);
+            ++expiredCount;
+        } else {
+            ++it;
         }
     }
+    pthread_mutex_unlock(&g_sessionsMutex);
     
-    for (size_t i = 0; i < expiredSessions.size(); ++i) {
-        destroySession(expiredSessions[i]);
-    }
-    
-    if (!expiredSessions.empty()) {
-        Logger::debug("Cleaned up " + Utils::intToString(expiredSessions.size()) + " expired sessions");
+    if (expiredCount > 0) {
+        Logger::debug("Cleaned up " + Utils::intToString(expiredCount) + " expired sessions");
     }
 }
 
 size_t Session::getSessionCount() {
-    return _sessions.size();
+    pthread_mutex_lock(&g_sessionsMutex);
+    size_t count = _sessions.size();
+    pthread_mutex_unlock(&g_sessionsMutex);
+    return count;
 }
 
 std::string Session::_generateSessionId() {
@@ -0,0 +1,49 @@
+#include "SharedBuffer.hpp"
+
+SharedBuffer::SharedBuffer() : _block(NULL) {
+}
+
+SharedBuffer::SharedBuffer(std::string& data) : _block(new Block()) {
+    _block->data.swap(data);
+    _block->refs = 1;
+}
+
+SharedBuffer::SharedBuffer(const SharedBuffer& other) : _block(other._block) {
+    if (_block) __sync_add_and_fetch(&_block->refs, 1);
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other) {
+    if (_block != other._block) {
+        if (other._block) __sync_add_and_fetch(&other._block->refs, 1);
+        _release();
+        _block = other._block;
+    }
+    return *this;
+}
+
+SharedBuffer::~SharedBuffer() {
+    _release();
+}
+
+void SharedBuffer::_release() {
+    if (_block && __sync_sub_and_fetch(&_block->refs, 1) == 0) delete _block;
+    _block = NULL;
+}
+
+bool SharedBuffer::isNull() const {
+    return _block == NULL;
+}
+
+const char* SharedBuffer::data() const {
+    if (!_block) return NULL;
+    return _block->data.data();
+}
+
+size_t SharedBuffer::size() const {
+    if (!_block) return 0;
+    return _block->data.size();
+}
+
+void SharedBuffer::reset() {
+    _release();
+}
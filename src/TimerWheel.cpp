@@ -0,0 +1,168 @@
+#include "TimerWheel.hpp"
+
+TimerWheel::Timer::Timer() : prev(NULL), next(NULL), expires(0), owner(NULL), kind(0) {
+}
+
+TimerWheel::Timer::Timer(const Timer& other) : prev(NULL), next(NULL), expires(0), owner(other.owner), kind(other.kind) {
+}
+
+TimerWheel::Timer& TimerWheel::Timer::operator=(const Timer& other) {
+    // Keep this node's own links and identity; only the caller re-arms it
+    (void)other;
+    return *this;
+}
+
+bool TimerWheel::Timer::isArmed() const {
+    return next != NULL;
+}
+
+TimerWheel::TimerWheel() : _current(0), _armed(0) {
+    for (int level = 0; level < LEVELS; ++level) {
+        for (int i = 0; i < SLOTS; ++i) {
+            _slots[level][i].prev = &_slots[level][i];
+            _slots[level][i].next = &_slots[level][i];
+        }
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    // Detach any timers still armed so their owners never see stale links
+    for (int level = 0; level < LEVELS; ++level) {
+        for (int i = 0; i < SLOTS; ++i) {
+            Timer* head = &_slots[level][i];
+            while (head->next != head) {
+                _unlink(*head->next);
+            }
+        }
+    }
+}
+
+// Place a timer in the slot that will be processed (or cascaded) no later
+// than its expiry tick.
+void TimerWheel::_insert(Timer& timer) {
+    if (timer.expires < _current) timer.expires = _current;
+    long long delta = timer.expires - _current;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1LL << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    long long maxDelta = (1LL << (SLOT_BITS * LEVELS)) - 1;
+    if (delta > maxDelta) timer.expires = _current + maxDelta;
+
+    int index = (int)((timer.expires >> (SLOT_BITS * level)) & (SLOTS - 1));
+    Timer* head = &_slots[level][index];
+    timer.prev = head->prev;
+    timer.next = head;
+    head->prev->next = &timer;
+    head->prev = &timer;
+}
+
+void TimerWheel::_unlink(Timer& timer) {
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = NULL;
+    timer.next = NULL;
+}
+
+// Redistribute one slot of a coarser level into the finer levels. Returns
+// true when the next level up has to be cascaded too.
+bool TimerWheel::_cascade(int level, int index) {
+    Timer* head = &_slots[level][index];
+    Timer pending;
+    if (head->next != head) {
+        // Move the whole list aside first: re-inserting may target this slot
+        pending.next = head->next;
+        pending.prev = head->prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head->next = head;
+        head->prev = head;
+        while (pending.next != &pending) {
+            Timer* timer = pending.next;
+            _unlink(*timer);
+            _insert(*timer);
+        }
+    }
+    return index == 0;
+}
+
+void TimerWheel::schedule(Timer& timer, long long deadlineMs) {
+    if (timer.isArmed()) {
+        _unlink(timer);
+    } else {
+        ++_armed;
+    }
+    // Round up so a timer never fires before its deadline
+    timer.expires = (deadlineMs + TICK_MS - 1) / TICK_MS;
+    _insert(timer);
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (!timer.isArmed()) return;
+    _unlink(timer);
+    --_armed;
+}
+
+void TimerWheel::advance(long long nowMs, std::vector<Timer*>& expired) {
+    long long nowTick = nowMs / TICK_MS;
+    if (_armed == 0) {
+        // Nothing to fire: jump straight to the present
+        if (_current <= nowTick) _current = nowTick + 1;
+        return;
+    }
+
+    while (_current <= nowTick) {
+        int index = (int)(_current & (SLOTS - 1));
+        if (index == 0) {
+            for (int level = 1; level < LEVELS; ++level) {
+                int levelIndex = (int)((_current >> (SLOT_BITS * level)) & (SLOTS - 1));
+                if (!_cascade(level, levelIndex)) break;
+            }
+        }
+
+        Timer* head = &_slots[0][index];
+        while (head->next != head) {
+            Timer* timer = head->next;
+            _unlink(*timer);
+            --_armed;
+            expired.push_back(timer);
+        }
+        ++_current;
+        if (_armed == 0 && _current <= nowTick) _current = nowTick + 1;
+    }
+}
+
+// The earliest tick at which something is due: for level 0 that is the
+// first non-empty slot, for coarser levels the tick at which the first
+// non-empty slot gets cascaded (never later than any of its timers).
+int TimerWheel::nextTimeoutMs(long long nowMs) const {
+    if (_armed == 0) return -1;
+
+    long long next = -1;
+    for (int level = 0; level < LEVELS; ++level) {
+        int shift = SLOT_BITS * level;
+        long long span = 1LL << shift;
+        // First tick >= _current where this level is processed
+        long long tick = ((_current + span - 1) >> shift) << shift;
+        for (int i = 0; i < SLOTS; ++i, tick += span) {
+            if (next != -1 && tick >= next) break;
+            int index = (int)((tick >> shift) & (SLOTS - 1));
+            const Timer* head = &_slots[level][index];
+            if (head->next != head) {
+                next = tick;
+                break;
+            }
+        }
+    }
+    if (next == -1) return -1;
+
+    long long waitMs = next * TICK_MS - nowMs;
+    if (waitMs < 0) return 0;
+    if (waitMs > 0x7fffffffLL) return 0x7fffffff;
+    return (int)waitMs;
+}
+
+size_t TimerWheel::size() const {
+    return _armed;
+}
@@ -93,6 +93,12 @@ std::string Utils::intToString(int value) {
     return ss.str();
 }
 
+std::string Utils::sizeToString(size_t value) {
+    std::stringstream ss;
+    ss << value;
+    return ss.str();
+}
+
 int Utils::stringToInt(const std::string& str) {
     return std::atoi(str.c_str());
 }
@@ -192,14 +198,17 @@ std::string Utils::getStatusMessage(int statusCode) {
         case 200: return "OK";
         case 201: return "Created";
         case 204: return "No Content";
+        case 206: return "Partial Content";
         case 301: return "Moved Permanently";
         case 302: return "Found";
+        case 304: return "Not Modified";
         case 400: return "Bad Request";
         case 403: return "Forbidden";
         case 404: return "Not Found";
         case 405: return "Method Not Allowed";
         case 408: return "Request Timeout";
         case 413: return "Payload Too Large";
+        case 416: return "Range Not Satisfiable";
         case 500: return "Internal Server Error";
         case 501: return "Not Implemented";
         case 502: return "Bad Gateway";
@@ -289,13 +298,71 @@ size_t Utils::hexToSize(const std::string& hex) {
 }
 
 std::string Utils::getCurrentTime() {
-    time_t now = time(0);
-    struct tm* timeinfo = gmtime(&now);
+    return formatHttpDate(time(0));
+}
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string Utils::formatHttpDate(time_t when) {
+    struct tm timeinfo;
+    gmtime_r(&when, &timeinfo);
     char buffer[80];
-    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", timeinfo);
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
     return std::string(buffer);
 }
 
+// Only the IMF-fixdate form is accepted; obsolete formats fail to parse
+bool Utils::parseHttpDate(const std::string& value, time_t& when) {
+    struct tm timeinfo;
+    memset(&timeinfo, 0, sizeof(timeinfo));
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &timeinfo);
+    if (!end || *end != '\0') return false;
+    when = timegm(&timeinfo);
+    return when != (time_t)-1;
+}
+
+// Per-thread so that each event-loop thread owns its own cached reading
+static __thread long long g_cachedNowMs = 0;
+
+void Utils::updateClock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    g_cachedNowMs = (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+long long Utils::nowMs() {
+    if (g_cachedNowMs == 0) updateClock();
+    return g_cachedNowMs;
+}
+
+time_t Utils::now() {
+    return (time_t)(nowMs() / 1000);
+}
+
+size_t Utils::getResidentMemory() {
+#ifdef __linux__
+    // Second field of /proc/self/statm: resident set size in pages
+    int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    char buf[128];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    ::close(fd);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+    unsigned long sizePages = 0;
+    unsigned long residentPages = 0;
+    if (sscanf(buf, "%lu %lu", &sizePages, &residentPages) != 2) return 0;
+    return (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+unsigned long long Utils::threadCpuMicros() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+}
+
 void Utils::setNonBlocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags == -1) {
@@ -306,3 +373,14 @@ void Utils::setNonBlocking(int fd) {
         Logger::error("fcntl F_SETFL failed");
     }
 }
+
+void Utils::setCloseOnExec(int fd) {
+    int flags = fcntl(fd, F_GETFD, 0);
+    if (flags == -1) {
+        Logger::error("fcntl F_GETFD failed");
+        return;
+    }
+    if (fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
+        Logger::error("fcntl F_SETFD failed");
+    }
+}
@@ -0,0 +1,114 @@
+#include "VariantCache.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+
+VariantCache::VariantCache(size_t budget)
+    : _bytes(0), _budget(budget), _hits(0), _misses(0), _concurrent(0), _evictions(0), _savedMicros(0) {
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+VariantCache::~VariantCache() {
+    pthread_mutex_destroy(&_mutex);
+}
+
+void VariantCache::configure(size_t budget) {
+    clear();
+    pthread_mutex_lock(&_mutex);
+    _budget = budget;
+    pthread_mutex_unlock(&_mutex);
+}
+
+// The budget only changes in configure(), before loop threads start
+bool VariantCache::isEnabled() const {
+    return _budget > 0;
+}
+
+void VariantCache::_erase(EntryList::iterator it) {
+    _bytes -= it->variant.size();
+    _index.erase(it->key);
+    _entries.erase(it);
+}
+
+bool VariantCache::acquire(const std::string& key, SharedBuffer& variant, bool& owner) {
+    pthread_mutex_lock(&_mutex);
+    EntryIndex::iterator found = _index.find(key);
+    if (found != _index.end()) {
+        EntryList::iterator it = found->second;
+        _entries.splice(_entries.begin(), _entries, it);
+        variant = it->variant;
+        ++_hits;
+        _savedMicros += it->cpuMicros;
+        pthread_mutex_unlock(&_mutex);
+        return true;
+    }
+    // Another thread is compressing these bytes. Waiting for it would stall
+    // every connection of the calling loop: the caller makes its own copy.
+    owner = _pending.count(key) == 0;
+    if (owner) {
+        ++_misses;
+        _pending.insert(key);
+    } else {
+        ++_concurrent;
+    }
+    pthread_mutex_unlock(&_mutex);
+    return false;
+}
+
+bool VariantCache::peek(const std::string& key, SharedBuffer& variant) {
+    pthread_mutex_lock(&_mutex);
+    EntryIndex::iterator found = _index.find(key);
+    bool cached = found != _index.end();
+    if (cached) variant = found->second->variant;
+    pthread_mutex_unlock(&_mutex);
+    return cached;
+}
+
+void VariantCache::store(const std::string& key, const SharedBuffer& variant, unsigned long long cpuMicros) {
+    pthread_mutex_lock(&_mutex);
+    _pending.erase(key);
+    // One variant may not take more than a quarter of the budget
+    if (variant.size() <= _budget / 4 && _index.find(key) == _index.end()) {
+        while (!_entries.empty() && _bytes + variant.size() > _budget) {
+            _erase(--_entries.end());
+            ++_evictions;
+        }
+        _entries.push_front(Entry());
+        Entry& entry = _entries.front();
+        entry.key = key;
+        entry.variant = variant;
+        entry.cpuMicros = cpuMicros;
+        _index[key] = _entries.begin();
+        _bytes += variant.size();
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+void VariantCache::abandon(const std::string& key) {
+    pthread_mutex_lock(&_mutex);
+    _pending.erase(key);
+    pthread_mutex_unlock(&_mutex);
+}
+
+void VariantCache::clear() {
+    pthread_mutex_lock(&_mutex);
+    _entries.clear();
+    _index.clear();
+    _bytes = 0;
+    pthread_mutex_unlock(&_mutex);
+}
+
+unsigned long long VariantCache::getSavedMicros() const {
+    return _savedMicros;
+}
+
+void VariantCache::logStats() {
+    pthread_mutex_lock(&_mutex);
+    if (_hits != 0 || _misses != 0) {
+        Logger::info("Compression cache: " + Utils::intToString((int)_hits) + " hits, " +
+                     Utils::intToString((int)_misses) + " misses (" + Utils::intToString((int)_concurrent) +
+                     " made concurrently), " + Utils::intToString((int)_evictions) + " evictions, " +
+                     Utils::sizeToString(_bytes) + " bytes cached, " +
+                     Utils::sizeToString((size_t)(_savedMicros / 1000)) + " ms of compression CPU saved");
+    }
+    pthread_mutex_unlock(&_mutex);
+}
@@ -0,0 +1,245 @@
+#include "WorkerPool.hpp"
+#include "Utils.hpp"
+#include "Logger.hpp"
+#include <iomanip>
+#ifdef __linux__
+# include <sys/eventfd.h>
+#endif
+
+WorkerPool::Job::Job() : owner(NULL), submittedAt(0), startedAt(0), finishedAt(0), ran(false) {
+}
+
+WorkerPool::Job::~Job() {
+}
+
+WorkerPool::CompletionQueue::CompletionQueue() : _wakeReadFd(-1), _wakeWriteFd(-1) {
+    pthread_mutex_init(&_mutex, NULL);
+}
+
+WorkerPool::CompletionQueue::~CompletionQueue() {
+    close();
+    pthread_mutex_destroy(&_mutex);
+}
+
+void WorkerPool::CompletionQueue::open() {
+    if (_wakeReadFd != -1) return;
+#ifdef __linux__
+    _wakeReadFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeReadFd < 0) {
+        throw std::runtime_error("eventfd() failed: " + std::string(strerror(errno)));
+    }
+    _wakeWriteFd = _wakeReadFd;
+#else
+    int fds[2];
+    if (pipe(fds) < 0) {
+        throw std::runtime_error("pipe() failed: " + std::string(strerror(errno)));
+    }
+    for (int i = 0; i < 2; ++i) {
+        Utils::setNonBlocking(fds[i]);
+        Utils::setCloseOnExec(fds[i]);
+    }
+    _wakeReadFd = fds[0];
+    _wakeWriteFd = fds[1];
+#endif
+}
+
+// Jobs not collected by now are deleted with the queue
+void WorkerPool::CompletionQueue::close() {
+    pthread_mutex_lock(&_mutex);
+    for (size_t i = 0; i < _done.size(); ++i) delete _done[i];
+    _done.clear();
+    pthread_mutex_unlock(&_mutex);
+    if (_wakeWriteFd != -1 && _wakeWriteFd != _wakeReadFd) ::close(_wakeWriteFd);
+    if (_wakeReadFd != -1) ::close(_wakeReadFd);
+    _wakeReadFd = -1;
+    _wakeWriteFd = -1;
+}
+
+bool WorkerPool::CompletionQueue::isOpen() const {
+    return _wakeReadFd != -1;
+}
+
+int WorkerPool::CompletionQueue::getWakeFd() const {
+    return _wakeReadFd;
+}
+
+void WorkerPool::CompletionQueue::push(Job* job) {
+    pthread_mutex_lock(&_mutex);
+    bool wasEmpty = _done.empty();
+    _done.push_back(job);
+    pthread_mutex_unlock(&_mutex);
+    // One wakeup covers every job queued before the loop drains
+    if (!wasEmpty) return;
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(_wakeWriteFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        Logger::error("WorkerPool: eventfd write failed: " + std::string(strerror(errno)));
+    }
+#else
+    char byte = 1;
+    if (write(_wakeWriteFd, &byte, 1) < 0 && errno != EAGAIN) {
+        Logger::error("WorkerPool: wakeup pipe write failed: " + std::string(strerror(errno)));
+    }
+#endif
+}
+
+void WorkerPool::CompletionQueue::drain(std::vector<Job*>& out) {
+#ifdef __linux__
+    uint64_t count;
+    while (read(_wakeReadFd, &count, sizeof(count)) > 0) {}
+#else
+    char buf[256];
+    while (read(_wakeReadFd, buf, sizeof(buf)) > 0) {}
+#endif
+    out.clear();
+    pthread_mutex_lock(&_mutex);
+    out.swap(_done);
+    pthread_mutex_unlock(&_mutex);
+}
+
+WorkerPool::WorkerPool()
+    : _maxQueue(0), _stopping(false), _submitted(0), _rejected(0), _completed(0), _depthTotal(0), _maxDepth(0),
+      _waitMicros(0), _maxWaitMicros(0), _runMicros(0), _maxRunMicros(0) {
+    pthread_mutex_init(&_mutex, NULL);
+    pthread_cond_init(&_ready, NULL);
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+    pthread_cond_destroy(&_ready);
+    pthread_mutex_destroy(&_mutex);
+}
+
+void WorkerPool::start(size_t threads, size_t maxQueue) {
+    if (isRunning() || threads == 0) return;
+    _maxQueue = maxQueue;
+    _stopping = false;
+
+    // Termination signals belong to the acceptor thread, as for loop threads
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    for (size_t i = 0; i < threads; ++i) {
+        pthread_t thread;
+        int err = pthread_create(&thread, NULL, _threadMain, this);
+        if (err != 0) {
+            pthread_sigmask(SIG_SETMASK, &previous, NULL);
+            stop();
+            throw std::runtime_error("pthread_create() failed: " + std::string(strerror(err)));
+        }
+        _threads.push_back(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    Logger::info("Started " + Utils::sizeToString(threads) + " worker pool threads");
+}
+
+void WorkerPool::stop() {
+    if (_threads.empty()) return;
+    pthread_mutex_lock(&_mutex);
+    _stopping = true;
+    pthread_cond_broadcast(&_ready);
+    pthread_mutex_unlock(&_mutex);
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        pthread_join(_threads[i], NULL);
+    }
+    _threads.clear();
+
+    // Their owners still expect them back, if only to be released
+    while (!_queue.empty()) {
+        _queue.front().completions->push(_queue.front().job);
+        _queue.pop_front();
+    }
+}
+
+// Only the thread that starts and stops the pool may ask
+bool WorkerPool::isRunning() const {
+    return !_threads.empty();
+}
+
+bool WorkerPool::submit(Job* job, CompletionQueue* completions) {
+    pthread_mutex_lock(&_mutex);
+    if (_stopping || _queue.size() >= _maxQueue) {
+        ++_rejected;
+        pthread_mutex_unlock(&_mutex);
+        return false;
+    }
+    job->submittedAt = nowMicros();
+    Entry entry;
+    entry.job = job;
+    entry.completions = completions;
+    _queue.push_back(entry);
+    ++_submitted;
+    _depthTotal += _queue.size();
+    if (_queue.size() > _maxDepth) _maxDepth = _queue.size();
+    pthread_cond_signal(&_ready);
+    pthread_mutex_unlock(&_mutex);
+    return true;
+}
+
+size_t WorkerPool::getQueueDepth() {
+    pthread_mutex_lock(&_mutex);
+    size_t depth = _queue.size();
+    pthread_mutex_unlock(&_mutex);
+    return depth;
+}
+
+void* WorkerPool::_threadMain(void* arg) {
+    static_cast<WorkerPool*>(arg)->_work();
+    return NULL;
+}
+
+void WorkerPool::_work() {
+    pthread_mutex_lock(&_mutex);
+    for (;;) {
+        while (_queue.empty() && !_stopping) {
+            pthread_cond_wait(&_ready, &_mutex);
+        }
+        if (_stopping) break;
+        Entry entry = _queue.front();
+        _queue.pop_front();
+        pthread_mutex_unlock(&_mutex);
+
+        Job* job = entry.job;
+        job->startedAt = nowMicros();
+        job->run();
+        job->finishedAt = nowMicros();
+        job->ran = true;
+
+        pthread_mutex_lock(&_mutex);
+        unsigned long long waited = job->startedAt - job->submittedAt;
+        unsigned long long ran = job->finishedAt - job->startedAt;
+        ++_completed;
+        _waitMicros += waited;
+        _runMicros += ran;
+        if (waited > _maxWaitMicros) _maxWaitMicros = waited;
+        if (ran > _maxRunMicros) _maxRunMicros = ran;
+        // The job belongs to its loop again once pushed: no access after this
+        entry.completions->push(job);
+    }
+    pthread_mutex_unlock(&_mutex);
+}
+
+unsigned long long WorkerPool::nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+void WorkerPool::logStats() {
+    pthread_mutex_lock(&_mutex);
+    if (_submitted != 0 || _rejected != 0) {
+        std::ostringstream stats;
+        stats << std::fixed << std::setprecision(2) << "Worker pool: " << _completed << " jobs run, " << _rejected
+              << " rejected (queue full), queue depth avg " << (_submitted ? (double)_depthTotal / _submitted : 0.0)
+              << " max " << _maxDepth << ", wait avg "
+              << (_completed ? (double)_waitMicros / _completed / 1000 : 0.0) << " ms max "
+              << (double)_maxWaitMicros / 1000 << " ms, run avg "
+              << (_completed ? (double)_runMicros / _completed / 1000 : 0.0) << " ms max "
+              << (double)_maxRunMicros / 1000 << " ms";
+        Logger::info(stats.str());
+    }
+    pthread_mutex_unlock(&_mutex);
+}